@@ -0,0 +1,41 @@
+/*
+  ==============================================================================
+
+    ChordIndex.cpp
+
+  ==============================================================================
+*/
+
+#include "ChordIndex.h"
+#include "MidiMapping.h"
+
+ChordIndex::ChordIndex(const MidiMapping& mapping)
+{
+    if (mapping.size() == 0) { return; }
+    size_t capacity = 16;
+    while (capacity < 2 * mapping.size()) { capacity *= 2; }
+    slots.resize(capacity);
+    byPitchClasses.assign((size_t) numPitchClassMasks, notFound);
+
+    // forEach goes by ascending key, so keeping the first key of a chord keeps the lowest
+    mapping.forEach([this, &mapping](int mappingKey, const std::vector<int>&)
+    {
+        const auto& pitchMask = mapping.find(mappingKey)->pitchMask;
+        if ((pitchMask[0] | pitchMask[1]) == 0) { return; }
+        for (size_t slot = hash(pitchMask) & (slots.size() - 1);; slot = (slot + 1) & (slots.size() - 1))
+        {
+            auto& entry = slots[slot];
+            if (entry.mappingKey == notFound)
+            {
+                entry = { pitchMask, mappingKey };
+                break;
+            }
+            if (entry.pitchMask == pitchMask) { break; }
+        }
+        auto& byPitchClass = byPitchClasses[(size_t) ChordNames::toPitchClassMask(pitchMask)];
+        if (byPitchClass == notFound)
+        {
+            byPitchClass = mappingKey;
+        }
+    });
+}
@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    ChordIndex.h
+    The reverse of a MidiMapping: which mapping key a played chord belongs to.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ChordNames.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MidiMapping;
+
+// How a played chord is matched against the mapped ones
+enum class ChordMatching : std::uint8_t
+{
+    off,
+    exact,      // the same notes
+    anyOctave   // the same pitch classes, in any octave and voicing
+};
+
+// Built once per published mapping on the message thread, read by the audio thread,
+// and handed on with the mapping when it is shared with other instances.
+// JUCE-free, like LatchEngine.h.
+// Exact chords are found in an open addressing hash table keyed by their 128 bit pitch
+// set, chords in any octave in a table indexed by their 12 bit pitch class set, so
+// either lookup is O(1) no matter how many chords are mapped. If several keys map the
+// same chord, the lowest one is found.
+class ChordIndex
+{
+public:
+    static constexpr int notFound = -1;
+
+    ChordIndex() = default;
+    explicit ChordIndex(const MidiMapping& mapping);
+
+    // Audio thread safe
+    int findExact(const std::array<std::uint64_t, 2>& pitchMask) const
+    {
+        if (slots.empty() || (pitchMask[0] | pitchMask[1]) == 0) { return notFound; }
+        for (size_t slot = hash(pitchMask) & (slots.size() - 1);; slot = (slot + 1) & (slots.size() - 1))
+        {
+            const auto& entry = slots[slot];
+            if (entry.mappingKey == notFound) { return notFound; }
+            if (entry.pitchMask == pitchMask) { return entry.mappingKey; }
+        }
+    }
+    // Audio thread safe
+    int findPitchClasses(const int pitchClassMask) const
+    {
+        if (byPitchClasses.empty() || pitchClassMask <= 0 || pitchClassMask >= numPitchClassMasks) { return notFound; }
+        return byPitchClasses[(size_t) pitchClassMask];
+    }
+
+    static constexpr int numPitchClassMasks = ChordNames::numPitchClassMasks;
+
+private:
+    struct Slot
+    {
+        std::array<std::uint64_t, 2> pitchMask {};
+        int mappingKey = notFound;
+    };
+
+    static size_t hash(const std::array<std::uint64_t, 2>& pitchMask)
+    {
+        // Chords differ in few bits, so mix all of them into the low ones the table uses
+        std::uint64_t h = (pitchMask[0] ^ (pitchMask[1] * 0x9e3779b97f4a7c15ull)) * 0xff51afd7ed558ccdull;
+        return (size_t) (h ^ (h >> 32));
+    }
+
+    // Power of two sized, at most half full so probes stay short
+    std::vector<Slot> slots;
+    // Empty if nothing is mapped, numPitchClassMasks entries otherwise
+    std::vector<int> byPitchClasses;
+};
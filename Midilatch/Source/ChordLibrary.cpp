@@ -0,0 +1,225 @@
+/*
+  ==============================================================================
+
+    ChordLibrary.cpp
+
+  ==============================================================================
+*/
+
+#include "ChordLibrary.h"
+#include <algorithm>
+
+namespace
+{
+    const char magic[4] = { 'M', 'L', 'L', 'B' };
+    constexpr size_t songRecordSize = 16;
+
+    int compareUTF8(const char* a, size_t aSize, const char* b, size_t bSize)
+    {
+        const int result = std::memcmp(a, b, std::min(aSize, bSize));
+        if (result != 0) { return result; }
+        return aSize < bSize ? -1 : (aSize > bSize ? 1 : 0);
+    }
+}
+
+juce::Result ChordLibrary::open(const juce::File& newFile)
+{
+    auto newMappedFile = std::make_unique<juce::MemoryMappedFile>(newFile, juce::MemoryMappedFile::readOnly);
+    const auto* bytes = static_cast<const juce::uint8*>(newMappedFile->getData());
+    const size_t newSize = newMappedFile->getSize();
+    if (bytes == nullptr)
+    {
+        return juce::Result::fail("Could not open " + newFile.getFullPathName());
+    }
+    if (newSize < (size_t) headerSize || std::memcmp(bytes, magic, sizeof(magic)) != 0)
+    {
+        return juce::Result::fail("Not a Midilatch chord library");
+    }
+    const int version = juce::ByteOrder::littleEndianShort(bytes + 4);
+    const size_t storedHeaderSize = juce::ByteOrder::littleEndianShort(bytes + 6);
+    const juce::uint32 storedNumSongs = juce::ByteOrder::littleEndianInt(bytes + 8);
+    if (version < 1)
+    {
+        return juce::Result::fail("Chord library is corrupt: invalid format version");
+    }
+    if (version > currentVersion)
+    {
+        return juce::Result::fail("Chord library was written by a newer version of Midilatch");
+    }
+    if (storedHeaderSize < (size_t) headerSize || storedHeaderSize > newSize
+        || (newSize - storedHeaderSize) / songRecordSize < storedNumSongs)
+    {
+        return juce::Result::fail("Chord library is truncated");
+    }
+
+    // The records themselves are checked when a song is used, so opening stays flat.
+    // Only now is the library open so far replaced.
+    file = newFile;
+    mappedFile = std::move(newMappedFile);
+    data = bytes;
+    size = newSize;
+    numSongs = storedNumSongs;
+    indexOffset = storedHeaderSize;
+    return juce::Result::ok();
+}
+
+void ChordLibrary::close()
+{
+    file = juce::File();
+    mappedFile.reset();
+    data = nullptr;
+    size = 0;
+    numSongs = 0;
+    indexOffset = 0;
+}
+
+ChordLibrary::SongRecord ChordLibrary::getSongRecord(int index) const
+{
+    jassert (index >= 0 && index < getNumSongs());
+    const auto* record = data + indexOffset + (size_t) index * songRecordSize;
+    SongRecord song { juce::ByteOrder::littleEndianInt(record), juce::ByteOrder::littleEndianInt(record + 4),
+                      juce::ByteOrder::littleEndianInt(record + 8), juce::ByteOrder::littleEndianInt(record + 12) };
+    // A name outside the file reads as empty
+    if (song.nameOffset > size || size - song.nameOffset < song.nameSize)
+    {
+        song.nameOffset = 0;
+        song.nameSize = 0;
+    }
+    return song;
+}
+
+juce::String ChordLibrary::getSongName(int index) const
+{
+    if (index < 0 || index >= getNumSongs()) { return {}; }
+    const auto song = getSongRecord(index);
+    return juce::String::fromUTF8((const char*) data + song.nameOffset, (int) song.nameSize);
+}
+
+int ChordLibrary::indexOfSong(const juce::String& name) const
+{
+    const auto* utf8 = name.toRawUTF8();
+    const size_t utf8Size = name.getNumBytesAsUTF8();
+    int low = 0;
+    int high = getNumSongs();
+    while (low < high)
+    {
+        const int middle = low + (high - low) / 2;
+        const auto song = getSongRecord(middle);
+        const int comparison = compareUTF8((const char*) data + song.nameOffset, song.nameSize, utf8, utf8Size);
+        if (comparison == 0) { return middle; }
+        if (comparison < 0) { low = middle + 1; }
+        else { high = middle; }
+    }
+    return -1;
+}
+
+juce::Result ChordLibrary::loadSong(int index, MidiMapping& mapping) const
+{
+    if (index < 0 || index >= getNumSongs())
+    {
+        return juce::Result::fail("No such song in the chord library");
+    }
+    const auto song = getSongRecord(index);
+    if (song.chordsOffset > size)
+    {
+        return juce::Result::fail("Chord library is truncated");
+    }
+
+    const auto* position = data + song.chordsOffset;
+    const auto* end = data + size;
+    MidiMapping readMapping;
+    for (juce::uint32 i = 0; i < song.numChords; ++i)
+    {
+        if (end - position < 6)
+        {
+            return juce::Result::fail("Chord library is truncated");
+        }
+        const juce::uint32 key = juce::ByteOrder::littleEndianInt(position);
+        const size_t numNotes = juce::ByteOrder::littleEndianShort(position + 4);
+        position += 6;
+        if (key >= (juce::uint32) MidiMapping::numKeys || (size_t) (end - position) < numNotes)
+        {
+            return juce::Result::fail("Chord library contains an invalid chord");
+        }
+        if (std::any_of(position, position + numNotes, [](juce::uint8 note) { return note > 127; }))
+        {
+            return juce::Result::fail("Chord library contains a note out of range");
+        }
+        readMapping.assign((int) key, std::vector<int>(position, position + numNotes));
+        position += numNotes;
+    }
+    mapping = std::move(readMapping);
+    return juce::Result::ok();
+}
+
+juce::Result ChordLibrary::write(const juce::File& file, std::vector<std::pair<juce::String, MidiMapping>> songs)
+{
+    std::sort(songs.begin(), songs.end(), [](const auto& a, const auto& b)
+    {
+        return compareUTF8(a.first.toRawUTF8(), a.first.getNumBytesAsUTF8(), b.first.toRawUTF8(), b.first.getNumBytesAsUTF8()) < 0;
+    });
+    const auto duplicate = std::adjacent_find(songs.begin(), songs.end(), [](const auto& a, const auto& b) { return a.first == b.first; });
+    if (duplicate != songs.end())
+    {
+        return juce::Result::fail("Song " + duplicate->first + " is in the library twice");
+    }
+
+    // Chords and names are laid out first, their offsets only depend on the index size
+    const size_t chordsStart = (size_t) headerSize + songs.size() * songRecordSize;
+    juce::MemoryOutputStream chords, names;
+    std::vector<SongRecord> records;
+    for (const auto& song : songs)
+    {
+        SongRecord record { (juce::uint32) names.getPosition(), (juce::uint32) song.first.getNumBytesAsUTF8(),
+                            (juce::uint32) (chordsStart + chords.getPosition()), (juce::uint32) song.second.size() };
+        song.second.forEach([&chords](int key, const std::vector<int>& notes)
+        {
+            chords.writeInt(key);
+            chords.writeShort((short) notes.size());
+            for (int note : notes)
+            {
+                chords.writeByte((char) note);
+            }
+        });
+        names.write(song.first.toRawUTF8(), record.nameSize);
+        records.push_back(record);
+    }
+    const size_t namesStart = chordsStart + chords.getDataSize();
+    if (namesStart + names.getDataSize() > 0xffffffffu)
+    {
+        return juce::Result::fail("Chord library would be larger than 4 GB");
+    }
+
+    juce::TemporaryFile temporaryFile(file);
+    {
+        juce::FileOutputStream stream(temporaryFile.getFile());
+        if (!stream.openedOk())
+        {
+            return juce::Result::fail("Could not write " + file.getFullPathName());
+        }
+        stream.write(magic, sizeof(magic));
+        stream.writeShort((short) currentVersion);
+        stream.writeShort((short) headerSize);
+        stream.writeInt((int) songs.size());
+        stream.writeInt(0);
+        for (const auto& record : records)
+        {
+            stream.writeInt((int) (namesStart + record.nameOffset));
+            stream.writeInt((int) record.nameSize);
+            stream.writeInt((int) record.chordsOffset);
+            stream.writeInt((int) record.numChords);
+        }
+        stream.write(chords.getData(), chords.getDataSize());
+        stream.write(names.getData(), names.getDataSize());
+        stream.flush();
+        if (stream.getStatus().failed())
+        {
+            return stream.getStatus();
+        }
+    }
+    if (!temporaryFile.overwriteTargetFileWithTemporary())
+    {
+        return juce::Result::fail("Could not replace " + file.getFullPathName());
+    }
+    return juce::Result::ok();
+}
@@ -0,0 +1,78 @@
+/*
+  ==============================================================================
+
+    ChordLibrary.h
+    Songbook files holding the mappings of many songs, read through a memory
+    mapping so only the index and the chords of the selected song are touched.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "MidiMapping.h"
+#include <utility>
+#include <vector>
+
+// All values little endian.
+//
+//   Header (16 bytes)
+//     char[4]  magic "MLLB"
+//     uint16   format version
+//     uint16   header size, so later versions can append header fields
+//     uint32   number of songs
+//     uint32   reserved
+//   Song index, one 16 byte record per song, sorted by the names' utf-8 bytes
+//     uint32   offset of the song's name from the start of the file
+//     uint32   length of the name
+//     uint32   offset of the song's chords from the start of the file
+//     uint32   number of chords
+//   Chords, each song's in one block
+//     per chord: uint32 mapping key, uint16 number of notes, uint8 notes[]
+//   Song names, utf-8
+//
+// The chord records are the same as in StateFormat. Unlike a saved state there is no
+// checksum, since checking it would mean reading the whole file when it is opened.
+class ChordLibrary
+{
+public:
+    static constexpr int currentVersion = 1;
+    static constexpr int headerSize = 16;
+
+    ChordLibrary() = default;
+
+    // Maps the file and checks its header and song index, never reads any chords, so
+    // this takes the same time however many songs the library holds. If that fails, the
+    // library open before stays open.
+    juce::Result open(const juce::File& file);
+    void close();
+    bool isOpen() const { return mappedFile != nullptr; }
+    const juce::File& getFile() const { return file; }
+
+    int getNumSongs() const { return (int) numSongs; }
+    juce::String getSongName(int index) const;
+    // Binary search over the index, -1 if there is no such song
+    int indexOfSong(const juce::String& name) const;
+    // Reads only the song's block of chords. mapping is only assigned if all of them are valid.
+    juce::Result loadSong(int index, MidiMapping& mapping) const;
+
+    // Writes songs, given as name and mapping, to file. Names have to be unique.
+    static juce::Result write(const juce::File& file, std::vector<std::pair<juce::String, MidiMapping>> songs);
+
+private:
+    struct SongRecord
+    {
+        juce::uint32 nameOffset, nameSize, chordsOffset, numChords;
+    };
+    SongRecord getSongRecord(int index) const;
+
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    const juce::uint8* data = nullptr;
+    size_t size = 0;
+    juce::uint32 numSongs = 0;
+    size_t indexOffset = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (ChordLibrary)
+};
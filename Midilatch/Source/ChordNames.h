@@ -0,0 +1,190 @@
+/*
+  ==============================================================================
+
+    ChordNames.h
+    Chord names for every set of pitch classes, from tables built at compile
+    time. Free of JUCE, like LatchEngine.h, and safe to use on the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+namespace ChordNames
+{
+    constexpr int numPitchClassMasks = 1 << 12;
+
+    // Intervals are one bit per semitone above the root, the root being bit 0
+    struct Quality
+    {
+        std::uint16_t intervals;
+        const char* suffix;
+    };
+
+    constexpr std::uint16_t intervals(std::initializer_list<int> semitones)
+    {
+        std::uint16_t mask = 0;
+        for (int semitone : semitones) { mask = (std::uint16_t) (mask | (1 << semitone)); }
+        return mask;
+    }
+
+    // In order of preference: a set of pitch classes that reads as several of these with
+    // different roots (C6 and Am7, say) is named after the first one, unless the bass
+    // note is the root of another
+    inline constexpr std::array<Quality, 25> qualities {{
+        { intervals({ 0, 4, 7 }), "" },
+        { intervals({ 0, 3, 7 }), "m" },
+        { intervals({ 0, 4, 7, 10 }), "7" },
+        { intervals({ 0, 4, 7, 11 }), "maj7" },
+        { intervals({ 0, 3, 7, 10 }), "m7" },
+        { intervals({ 0, 3, 6 }), "dim" },
+        { intervals({ 0, 3, 6, 9 }), "dim7" },
+        { intervals({ 0, 3, 6, 10 }), "m7b5" },
+        { intervals({ 0, 4, 8 }), "aug" },
+        { intervals({ 0, 5, 7 }), "sus4" },
+        { intervals({ 0, 2, 7 }), "sus2" },
+        { intervals({ 0, 5, 7, 10 }), "7sus4" },
+        { intervals({ 0, 4, 7, 9 }), "6" },
+        { intervals({ 0, 3, 7, 9 }), "m6" },
+        { intervals({ 0, 3, 7, 11 }), "mMaj7" },
+        { intervals({ 0, 4, 8, 10 }), "aug7" },
+        { intervals({ 0, 2, 4, 7 }), "add9" },
+        { intervals({ 0, 2, 3, 7 }), "madd9" },
+        { intervals({ 0, 2, 4, 7, 10 }), "9" },
+        { intervals({ 0, 2, 4, 7, 11 }), "maj9" },
+        { intervals({ 0, 2, 3, 7, 10 }), "m9" },
+        { intervals({ 0, 2, 4, 7, 9 }), "6/9" },
+        { intervals({ 0, 1, 4, 7, 10 }), "7b9" },
+        { intervals({ 0, 3, 4, 7, 10 }), "7#9" },
+        { intervals({ 0, 7 }), "5" },
+    }};
+
+    inline constexpr std::array<const char*, 12> pitchClassNames { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+    // Transposes a set of pitch classes up by semitones
+    constexpr int rotate(const int pitchClassMask, const int semitones)
+    {
+        const int shift = ((semitones % 12) + 12) % 12;
+        return ((pitchClassMask << shift) | (pitchClassMask >> (12 - shift))) & (numPitchClassMasks - 1);
+    }
+
+    constexpr int noQuality = -1;
+
+    // The quality whose intervals are exactly the mask, or noQuality
+    inline constexpr auto qualityByIntervals = []
+    {
+        std::array<std::int8_t, numPitchClassMasks> table {};
+        for (auto& quality : table) { quality = noQuality; }
+        for (int quality = (int) qualities.size() - 1; quality >= 0; --quality)
+        {
+            table[qualities[(std::size_t) quality].intervals] = (std::int8_t) quality;
+        }
+        return table;
+    }();
+
+    struct Shape
+    {
+        std::int8_t root = -1;
+        std::int8_t quality = noQuality;
+
+        constexpr bool isKnown() const { return quality != noQuality; }
+    };
+
+    // The most preferred quality and root that form the mask. Filled by rotating every
+    // quality to every root instead of testing all roots of all masks, which keeps it
+    // well within what compilers evaluate at compile time.
+    inline constexpr auto shapeByPitchClasses = []
+    {
+        std::array<Shape, numPitchClassMasks> table {};
+        for (int quality = 0; quality < (int) qualities.size(); ++quality)
+        {
+            for (int root = 0; root < 12; ++root)
+            {
+                auto& shape = table[(std::size_t) rotate(qualities[(std::size_t) quality].intervals, root)];
+                if (!shape.isKnown())
+                {
+                    shape = { (std::int8_t) root, (std::int8_t) quality };
+                }
+            }
+        }
+        return table;
+    }();
+
+    constexpr int toPitchClassMask(const std::array<std::uint64_t, 2>& pitchMask)
+    {
+        int pitchClassMask = 0;
+        for (std::size_t word = 0; word < pitchMask.size(); ++word)
+        {
+            for (auto bits = pitchMask[word]; bits != 0; bits &= bits - 1)
+            {
+                pitchClassMask |= 1 << (((int) word * 64 + std::countr_zero(bits)) % 12);
+            }
+        }
+        return pitchClassMask;
+    }
+
+    // The chord formed by the pitch classes over the given bass. A chord in root
+    // position over its bass wins, then any other root (an inversion, so a slash chord
+    // over one of its own notes), then a chord over a foreign bass (C/D, say).
+    struct Chord
+    {
+        Shape shape;
+        std::int8_t bass = -1;
+
+        constexpr bool isKnown() const { return shape.isKnown(); }
+        constexpr bool isSlashChord() const { return shape.root != bass; }
+    };
+
+    constexpr Chord identify(const int pitchClassMask, const int bassPitchClass)
+    {
+        const int quality = qualityByIntervals[(std::size_t) rotate(pitchClassMask, -bassPitchClass)];
+        if (quality != noQuality)
+        {
+            return { { (std::int8_t) bassPitchClass, (std::int8_t) quality }, (std::int8_t) bassPitchClass };
+        }
+        const auto shape = shapeByPitchClasses[(std::size_t) pitchClassMask];
+        if (shape.isKnown())
+        {
+            return { shape, (std::int8_t) bassPitchClass };
+        }
+        return { shapeByPitchClasses[(std::size_t) (pitchClassMask & ~(1 << bassPitchClass))], (std::int8_t) bassPitchClass };
+    }
+
+    constexpr Chord identify(const std::array<std::uint64_t, 2>& pitchMask)
+    {
+        const int bass = pitchMask[0] != 0 ? std::countr_zero(pitchMask[0]) : pitchMask[1] != 0 ? 64 + std::countr_zero(pitchMask[1]) : -1;
+        if (bass < 0) { return {}; }
+        return identify(toPitchClassMask(pitchMask), bass % 12);
+    }
+
+    // E.g. "Cmaj7" or "Am/C", empty if the notes do not form a known chord
+    inline std::string getName(const Chord& chord)
+    {
+        if (!chord.isKnown()) { return {}; }
+        std::string name = pitchClassNames[(std::size_t) chord.shape.root];
+        name += qualities[(std::size_t) chord.shape.quality].suffix;
+        if (chord.isSlashChord())
+        {
+            name += '/';
+            name += pitchClassNames[(std::size_t) chord.bass];
+        }
+        return name;
+    }
+
+    inline std::string getName(const std::array<std::uint64_t, 2>& pitchMask)
+    {
+        return getName(identify(pitchMask));
+    }
+
+    static_assert (identify(intervals({ 0, 4, 7 }), 0).shape.quality == 0, "C E G is C major");
+    static_assert (identify(intervals({ 0, 4, 7, 9 }), 9).shape.root == 9, "A C E G over A is Am7");
+    static_assert (identify(intervals({ 0, 4, 7 }), 4).isSlashChord(), "C E G over E is C/E");
+    static_assert (identify(intervals({ 0, 2, 4, 7 }), 2).shape.root == 0, "C D E G over D is Cadd9/D");
+}
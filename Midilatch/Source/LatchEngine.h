@@ -0,0 +1,580 @@
+/*
+  ==============================================================================
+
+    LatchEngine.h
+    The latch and mapping logic of processBlock, working on raw midi bytes and
+    without any JUCE dependency, so it can be benchmarked and tested on its own.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Tracks the currently latched notes without touching the heap.
+// One 128 bit row per midi channel (16x128 bitset) plus the velocity of every
+// channel/note slot, so adding, removing and clearing are constant time and the
+// whole state lives inline in the processor.
+class LatchedNotes
+{
+public:
+    static constexpr int numChannels = 16;
+    static constexpr int numNotes = 128;
+    static constexpr int capacity = numChannels * numNotes;
+    // Channel masks have one bit per channel index
+    static constexpr std::uint16_t allChannels = 0xffff;
+    // Mapped chords are latched on "channel 0", which has always gone out as channel 1
+    static constexpr int mappingChannelIndex = 0;
+
+    // Channels are stored as a 0-15 index, i.e. the low nibble of the status byte.
+    // Out of range channels are clamped the way juce::MidiMessage does it.
+    static int toChannelIndex(const int channel) { return channel < 1 ? 0 : channel > numChannels ? numChannels - 1 : channel - 1; }
+
+    void add(const int note, const int channelIndex, const std::uint8_t velocity)
+    {
+        auto& word = bits[channelIndex][note >> 6];
+        const std::uint64_t mask = std::uint64_t(1) << (note & 63);
+        // Like the set this replaces, re-adding a latched note keeps its original velocity
+        if (word & mask) { return; }
+        word |= mask;
+        velocities[channelIndex][note] = velocity;
+        ++count;
+    }
+    bool contains(const int note, const int channelIndex) const
+    {
+        return (bits[channelIndex][note >> 6] >> (note & 63)) & 1;
+    }
+    std::uint8_t getVelocity(const int note, const int channelIndex) const { return velocities[channelIndex][note]; }
+    void setVelocity(const int note, const int channelIndex, const std::uint8_t velocity) { velocities[channelIndex][note] = velocity; }
+    // The 128 bit row of one channel
+    const std::array<std::uint64_t, 2>& getRow(const int channelIndex) const { return bits[channelIndex]; }
+    // Drops every latched note on the channels in channelMask, except those in keep on
+    // channelIndex. Channels outside channelMask are left alone.
+    void retainOnly(const std::uint16_t channelMask, const int channelIndex, const std::array<std::uint64_t, 2>& keep)
+    {
+        for (std::uint16_t channels = channelMask; channels; channels &= channels - 1)
+        {
+            const int index = std::countr_zero(channels);
+            auto& row = bits[index];
+            count -= std::popcount(row[0]) + std::popcount(row[1]);
+            row = index == channelIndex ? std::array<std::uint64_t, 2> { row[0] & keep[0], row[1] & keep[1] } : std::array<std::uint64_t, 2> {};
+            count += std::popcount(row[0]) + std::popcount(row[1]);
+        }
+    }
+    void clear() { bits = {}; count = 0; }
+    void clear(const std::uint16_t channelMask) { retainOnly(channelMask, -1, {}); }
+    // One bit per note, set if the note is latched on any of the channels in channelMask
+    std::array<std::uint64_t, 2> getPitchMask(const std::uint16_t channelMask = allChannels) const
+    {
+        std::array<std::uint64_t, 2> mask {};
+        for (std::uint16_t channels = channelMask; channels; channels &= channels - 1)
+        {
+            const auto& row = bits[std::countr_zero(channels)];
+            mask[0] |= row[0];
+            mask[1] |= row[1];
+        }
+        return mask;
+    }
+    bool isEmpty() const { return count == 0; }
+    int size() const { return count; }
+
+    // Calls fn(note, channelIndex, velocity) for every latched note on the channels in
+    // channelMask, ordered by note and then by channel
+    template <typename Fn>
+    void forEach(const std::uint16_t channelMask, Fn&& fn) const
+    {
+        const auto pitchMask = getPitchMask(channelMask);
+        for (int word = 0; word < 2; ++word)
+        {
+            for (std::uint64_t notesInWord = pitchMask[(std::size_t) word]; notesInWord; notesInWord &= notesInWord - 1)
+            {
+                const int note = word * 64 + std::countr_zero(notesInWord);
+                for (std::uint16_t channels = channelMask; channels; channels &= channels - 1)
+                {
+                    const int channelIndex = std::countr_zero(channels);
+                    if (contains(note, channelIndex))
+                    {
+                        fn(note, channelIndex, velocities[channelIndex][note]);
+                    }
+                }
+            }
+        }
+    }
+    template <typename Fn>
+    void forEach(Fn&& fn) const { forEach(allChannels, fn); }
+
+private:
+    std::array<std::array<std::uint64_t, 2>, numChannels> bits {};
+    std::array<std::array<std::uint8_t, numNotes>, numChannels> velocities {};
+    int count = 0;
+};
+
+
+// What minimal transitions do with a note that is latched in both the old and the new chord
+enum class SharedNotePolicy
+{
+    keepSounding,               // leave it alone, even if the new chord plays it at another velocity
+    retriggerIfVelocityChanged  // restart it if the velocity differs, so the new dynamics are heard
+};
+
+// What happens to a mapped note that transposing pushes outside of 0-127
+enum class TransposeBounds
+{
+    fold,   // move it back into range by whole octaves, keeping its pitch class
+    clamp,  // play the lowest or highest midi note instead
+    drop    // leave it out of the chord
+};
+
+// Applied to mapped chords as they are played, the stored chords stay as they are
+struct Transposition
+{
+    int offset = 0;
+    TransposeBounds bounds = TransposeBounds::fold;
+
+    // The note a mapped note is played as, or -1 if it is dropped
+    int apply(const int note) const
+    {
+        int transposed = note + offset;
+        if (transposed >= 0 && transposed < LatchedNotes::numNotes) { return transposed; }
+        switch (bounds)
+        {
+            case TransposeBounds::fold:
+                if (transposed < 0) { transposed += 12 * ((11 - transposed) / 12); }
+                if (transposed >= LatchedNotes::numNotes) { transposed -= 12 * ((transposed - LatchedNotes::numNotes + 12) / 12); }
+                return transposed;
+            case TransposeBounds::clamp:
+                return transposed < 0 ? 0 : LatchedNotes::numNotes - 1;
+            case TransposeBounds::drop:
+                break;
+        }
+        return -1;
+    }
+};
+
+//==============================================================================
+// Policies the engine is specialised on. Each combination compiles to its own loop,
+// so a configuration never pays for branches of the others.
+
+// What program changes do
+struct PedalMappedMode  { static constexpr bool storesChords = false; }; // fire the mapped chord
+struct RecordChordsMode { static constexpr bool storesChords = true;  }; // store the latched chord
+
+// How a new chord replaces the latched one, see MidilatchAudioProcessor::setMinimalTransitions
+struct FullTransitions    { static constexpr bool minimal = false; };
+struct MinimalTransitions { static constexpr bool minimal = true; };
+
+
+//==============================================================================
+// Everything the engine remembers between events, shared by all specialisations so
+// the processor can switch policies between blocks without losing latched notes.
+// Chord is the host's mapped chord type, see LatchEngine.
+template <typename Chord>
+struct LatchState
+{
+    static constexpr std::int64_t noChord = std::numeric_limits<std::int64_t>::min();
+
+    // One chord being latched, fed by the input channels assigned to it
+    struct Latch
+    {
+        // The mapped chord this latch's notes were filled from, as long as they are
+        // exactly that chord, so releasing it can use the chord's prebuilt note offs
+        const Chord* latchedChord = nullptr;
+        // The channels this latch has notes latched on
+        std::uint16_t channels = 0;
+        // True while keys are held down, i.e. further note ons join the chord
+        bool isRecording = false;
+        // With a capture window, the time of the chord's first note on
+        std::int64_t chordStartTime = noChord;
+        // Mapped chords fired from this latch are latched and sent on this channel
+        int mappingChannelIndex = LatchedNotes::mappingChannelIndex;
+        // The mapping key whose program change fired the latched chord, -1 once the
+        // latch was played or released otherwise
+        int firedMappingKey = -1;
+    };
+
+    LatchedNotes notes;
+    std::array<Latch, LatchedNotes::numChannels> latches {};
+    // The latch each input channel plays into. All channels share latch 0 by default,
+    // so a new chord on any channel replaces the latched one (which is also what an MPE
+    // zone needs). Giving channels latches of their own keeps e.g. the halves of a split
+    // keyboard apart. Latches are expected not to send on each other's channels.
+    std::array<std::uint8_t, LatchedNotes::numChannels> latchOfChannel {};
+    // Last bank select (CC0 MSB / CC32 LSB) per input channel
+    std::array<int, LatchedNotes::numChannels> selectedBank {};
+    SharedNotePolicy sharedNotePolicy = SharedNotePolicy::keepSounding;
+    Transposition transposition;
+    // Without a capture window (0), a chord is every note played before the first
+    // release. With one, it is every note on within this many samples of the chord's
+    // first, however the keys were released in between, so sloppy releases and legato
+    // playing group as intended. The first note still starts right away.
+    std::int64_t captureWindow = 0;
+    // The time of sample 0 of the block being processed, in samples on a clock that
+    // runs on across blocks, so a window spans block boundaries whatever their size
+    std::int64_t blockStartTime = 0;
+
+    void setMappingChannel(const int latchIndex, const int channelIndex)
+    {
+        auto& latch = latches[(std::size_t) latchIndex];
+        if (latch.mappingChannelIndex != channelIndex)
+        {
+            // A chord latched on the old channel has to be released note by note
+            latch.latchedChord = nullptr;
+            latch.mappingChannelIndex = channelIndex;
+        }
+    }
+    // Called when the chords the latches point to may be freed
+    void forgetLatchedChords()
+    {
+        for (auto& latch : latches) { latch.latchedChord = nullptr; }
+    }
+    // Called after latchOfChannel changed. Every latched note goes to the latch its
+    // channel now plays into, a latch no channel plays into would never release its
+    // notes. The next note on starts a new chord.
+    void regroupLatches()
+    {
+        std::uint16_t latchedChannels = 0;
+        for (auto& latch : latches)
+        {
+            latchedChannels |= latch.channels;
+            latch.latchedChord = nullptr;
+            latch.channels = 0;
+            latch.isRecording = false;
+            latch.chordStartTime = noChord;
+            latch.firedMappingKey = -1;
+        }
+        for (std::uint16_t channels = latchedChannels; channels; channels &= channels - 1)
+        {
+            const int channelIndex = std::countr_zero(channels);
+            latches[(std::size_t) (latchOfChannel[(std::size_t) channelIndex] & 0x0f)].channels |= (std::uint16_t) (1u << channelIndex);
+        }
+    }
+};
+
+//==============================================================================
+// Host is whatever connects the engine to the outside world. It provides:
+//
+//   using Chord = ...;   // has `notes` (iterable of ints) and `pitchMask` (std::array<std::uint64_t, 2>)
+//   void write(const std::uint8_t* bytes, int numBytes, int samplePosition);
+//   std::uint8_t chordVelocity(const std::array<std::uint64_t, 2>& pitchMask, int note); // what note of the chord pitchMask starts with
+//   void writeChordNoteOns(const Chord&, int channelIndex, int samplePosition);   // at chordVelocity
+//   void writeChordNote(int note, int channelIndex, int samplePosition);          // for a chord started note by note
+//   void chordWritten(const std::array<std::uint64_t, 2>& pitchMask, int channelIndex, int samplePosition); // after its last writeChordNote
+//   void writeChordNoteOffs(const Chord&, int channelIndex, int samplePosition);
+//   const Chord* findChord(int mappingKey);                                       // nullptr if unmapped
+//   void storeChord(int mappingKey, const std::array<std::uint64_t, 2>& pitchMask); // only with RecordChordsMode
+//   void programChanged(int mappingKey, const LatchedNotes&);                     // after a mapped program change
+//
+// Events are anything with `data`, `numBytes` and `samplePosition` members, such as
+// juce::MidiMessageMetadata. Every event only touches the latch of its own channel,
+// so its cost does not grow with the number of channels in use.
+template <typename Mode, typename Transitions>
+class LatchEngine
+{
+public:
+    template <typename Host>
+    using State = LatchState<typename Host::Chord>;
+    template <typename Host>
+    using Latch = typename State<Host>::Latch;
+
+    // Processes one block of events, returns true if the latched notes may have changed
+    template <typename Events, typename Host>
+    static bool process(State<Host>& state, const Events& events, Host& host)
+    {
+        bool latchedNotesChanged = false;
+        for (const auto& event : events)
+        {
+            latchedNotesChanged |= processEvent(state, event.data, event.numBytes, event.samplePosition, host);
+        }
+        return latchedNotesChanged;
+    }
+
+    template <typename Host>
+    static bool processEvent(State<Host>& state, const std::uint8_t* data, const int numBytes, const int samplePosition, Host& host)
+    {
+        // Sysex and other long or short messages are passed on untouched
+        if (numBytes != 3 && numBytes != 2)
+        {
+            host.write(data, numBytes, samplePosition);
+            return false;
+        }
+        const int type = data[0] & 0xf0;
+        const int channelIndex = data[0] & 0x0f;
+        auto& latch = state.latches[state.latchOfChannel[(std::size_t) channelIndex] & 0x0f];
+        if (numBytes == 3 && type == 0x90 && data[2] != 0)
+        {
+            if (state.captureWindow > 0)
+            {
+                // Decided on the spot from the chord's start, no lookahead. A clock that
+                // went backwards (a restart) starts a new chord too.
+                const std::int64_t time = state.blockStartTime + samplePosition;
+                latch.isRecording = latch.chordStartTime != State<Host>::noChord && time >= latch.chordStartTime
+                                    && time - latch.chordStartTime < state.captureWindow;
+                if (!latch.isRecording) { latch.chordStartTime = time; }
+            }
+            latch.firedMappingKey = -1;
+            noteOn(state.notes, latch, data[1], channelIndex, data[2], state.sharedNotePolicy, samplePosition, host);
+            return true;
+        }
+        if (numBytes == 3 && (type == 0x80 || type == 0x90))
+        {
+            // Do not pass the note off on (that's the whole point of the plugin)
+            latch.isRecording = false;
+            return false;
+        }
+        if (numBytes == 3 && type == 0xb0 && data[1] == 123)
+        {
+            // On all notes off, forget the latched notes - no need to send individual note
+            // offs. Except for those a shared latch holds on other channels, which the
+            // message does not reach.
+            state.notes.forEach(latch.channels & (std::uint16_t) ~channelBit(channelIndex), [&](int note, int latchedChannelIndex, std::uint8_t)
+            {
+                writeNote(host, 0x80, latchedChannelIndex, note, 0, samplePosition);
+            });
+            state.notes.clear(latch.channels);
+            latch.channels = 0;
+            latch.latchedChord = nullptr;
+            latch.chordStartTime = State<Host>::noChord;
+            latch.firedMappingKey = -1;
+            host.write(data, numBytes, samplePosition);
+            return true;
+        }
+        if (numBytes == 3 && type == 0xb0 && (data[1] == 0 || data[1] == 32))
+        {
+            // Bank select picks the bank for following program changes and is passed on as well
+            auto& bank = state.selectedBank[(std::size_t) channelIndex];
+            bank = data[1] == 0 ? (data[2] << 7) | (bank & 127) : (bank & ~127) | data[2];
+            host.write(data, numBytes, samplePosition);
+            return false;
+        }
+        if (type == 0xc0)
+        {
+            const int mappingKey = state.selectedBank[(std::size_t) channelIndex] * 128 + data[1];
+            return programChange(state, latch, mappingKey, samplePosition, host);
+        }
+        host.write(data, numBytes, samplePosition);
+        return false;
+    }
+
+private:
+    static std::uint16_t channelBit(const int channelIndex) { return (std::uint16_t) (1u << channelIndex); }
+
+    template <typename Host>
+    static void writeNote(Host& host, const int status, const int channelIndex, const int note, const std::uint8_t velocity, const int samplePosition)
+    {
+        const std::uint8_t bytes[] = { (std::uint8_t) (status | channelIndex), (std::uint8_t) note, velocity };
+        host.write(bytes, 3, samplePosition);
+    }
+
+    template <typename Host>
+    static void releaseAll(LatchedNotes& notes, Latch<Host>& latch, const int samplePosition, Host& host)
+    {
+        if (latch.latchedChord != nullptr)
+        {
+            // The latched set is exactly a mapped chord, whose note offs are ready to go
+            host.writeChordNoteOffs(*latch.latchedChord, latch.mappingChannelIndex, samplePosition);
+            latch.latchedChord = nullptr;
+        }
+        else
+        {
+            notes.forEach(latch.channels, [&](int note, int channelIndex, std::uint8_t)
+            {
+                writeNote(host, 0x80, channelIndex, note, 0, samplePosition);
+            });
+        }
+        notes.clear(latch.channels);
+        latch.channels = 0;
+    }
+
+    template <typename Host>
+    static void releaseAllExcept(LatchedNotes& notes, Latch<Host>& latch, const int note, const int channelIndex, const int samplePosition, Host& host)
+    {
+        // The rest of the new chord is not known yet, so only the note being played can be kept
+        notes.forEach(latch.channels, [&](int latchedNote, int latchedChannelIndex, std::uint8_t)
+        {
+            if (latchedNote != note || latchedChannelIndex != channelIndex)
+            {
+                writeNote(host, 0x80, latchedChannelIndex, latchedNote, 0, samplePosition);
+            }
+        });
+        std::array<std::uint64_t, 2> keep {};
+        keep[(std::size_t) (note >> 6)] = std::uint64_t(1) << (note & 63);
+        notes.retainOnly(latch.channels, channelIndex, keep);
+        latch.channels &= channelBit(channelIndex);
+        latch.latchedChord = nullptr;
+    }
+
+    template <typename Host>
+    static void noteOn(LatchedNotes& notes, Latch<Host>& latch, const int note, const int channelIndex, const std::uint8_t velocity,
+                       const SharedNotePolicy sharedNotePolicy, const int samplePosition, Host& host)
+    {
+        if (!latch.isRecording)
+        {
+            // A new chord starts, release the old one
+            if constexpr (Transitions::minimal)
+            {
+                releaseAllExcept(notes, latch, note, channelIndex, samplePosition, host);
+            }
+            else
+            {
+                releaseAll(notes, latch, samplePosition, host);
+            }
+        }
+        latch.isRecording = true;
+        latch.channels |= channelBit(channelIndex);
+        if constexpr (Transitions::minimal)
+        {
+            if (notes.contains(note, channelIndex))
+            {
+                // Already sounding, only restart it if the policy asks for it
+                if (sharedNotePolicy == SharedNotePolicy::retriggerIfVelocityChanged
+                    && notes.getVelocity(note, channelIndex) != velocity)
+                {
+                    writeNote(host, 0x80, channelIndex, note, 0, samplePosition);
+                    writeNote(host, 0x90, channelIndex, note, velocity, samplePosition);
+                    notes.setVelocity(note, channelIndex, velocity);
+                }
+                return;
+            }
+        }
+        notes.add(note, channelIndex, velocity);
+        writeNote(host, 0x90, channelIndex, note, velocity, samplePosition);
+    }
+
+    static void setBit(std::array<std::uint64_t, 2>& mask, const int note) { mask[(std::size_t) (note >> 6)] |= std::uint64_t(1) << (note & 63); }
+    static bool hasBit(const std::array<std::uint64_t, 2>& mask, const int note) { return (mask[(std::size_t) (note >> 6)] >> (note & 63)) & 1; }
+
+    template <typename Host>
+    static void fireChord(LatchedNotes& notes, Latch<Host>& latch, const typename Host::Chord& chord, const Transposition& transposition,
+                          const int samplePosition, Host& host)
+    {
+        const int channelIndex = latch.mappingChannelIndex;
+        latch.channels |= channelBit(channelIndex);
+        if (transposition.offset == 0)
+        {
+            // Same as playing every note of the chord on the mapping channel, but the host
+            // can send its prebuilt note ons in one go
+            for (int note : chord.notes)
+            {
+                notes.add(note, channelIndex, host.chordVelocity(chord.pitchMask, note));
+            }
+            host.writeChordNoteOns(chord, channelIndex, samplePosition);
+            latch.latchedChord = &chord;
+            return;
+        }
+        // Transposed chords go note by note, and each note only once since clamping
+        // can turn several notes into the same one. The prebuilt note offs don't match.
+        std::array<std::uint64_t, 2> pitchMask {};
+        for (int storedNote : chord.notes)
+        {
+            const int note = transposition.apply(storedNote);
+            if (note >= 0) { setBit(pitchMask, note); }
+        }
+        std::array<std::uint64_t, 2> started {};
+        for (int storedNote : chord.notes)
+        {
+            const int note = transposition.apply(storedNote);
+            if (note < 0 || hasBit(started, note)) { continue; }
+            setBit(started, note);
+            notes.add(note, channelIndex, host.chordVelocity(pitchMask, note));
+            host.writeChordNote(note, channelIndex, samplePosition);
+        }
+        host.chordWritten(pitchMask, channelIndex, samplePosition);
+        latch.latchedChord = nullptr;
+    }
+
+    template <typename Host>
+    static void transitionToChord(LatchedNotes& notes, Latch<Host>& latch, const typename Host::Chord& chord, const SharedNotePolicy sharedNotePolicy,
+                                  const Transposition& transposition, const int samplePosition, Host& host)
+    {
+        const int channelIndex = latch.mappingChannelIndex;
+        const auto latchedRow = (latch.channels & channelBit(channelIndex)) ? notes.getRow(channelIndex) : std::array<std::uint64_t, 2> {};
+        const bool transposed = transposition.offset != 0;
+        std::array<std::uint64_t, 2> pitchMask = chord.pitchMask;
+        if (transposed)
+        {
+            pitchMask = {};
+            for (int note : chord.notes)
+            {
+                const int transposedNote = transposition.apply(note);
+                if (transposedNote >= 0) { setBit(pitchMask, transposedNote); }
+            }
+        }
+        const bool retrigger = sharedNotePolicy == SharedNotePolicy::retriggerIfVelocityChanged;
+
+        // Notes to start: in the new chord but not latched on the mapping channel (a XOR
+        // masked down to the new side), plus shared notes that get retriggered
+        std::array<std::uint64_t, 2> toStart { (latchedRow[0] ^ pitchMask[0]) & pitchMask[0], (latchedRow[1] ^ pitchMask[1]) & pitchMask[1] };
+        notes.forEach(latch.channels, [&](int note, int latchedChannelIndex, std::uint8_t velocity)
+        {
+            const bool shared = latchedChannelIndex == channelIndex && hasBit(pitchMask, note);
+            if (!shared)
+            {
+                writeNote(host, 0x80, latchedChannelIndex, note, 0, samplePosition);
+            }
+            else if (retrigger && velocity != host.chordVelocity(pitchMask, note))
+            {
+                writeNote(host, 0x80, latchedChannelIndex, note, 0, samplePosition);
+                setBit(toStart, note);
+            }
+        });
+        notes.retainOnly(latch.channels, channelIndex, pitchMask);
+        latch.channels = channelBit(channelIndex);
+
+        // Note ons in the chord's own order, each note at most once
+        for (int storedNote : chord.notes)
+        {
+            const int note = transposed ? transposition.apply(storedNote) : storedNote;
+            if (note < 0) { continue; }
+            auto& word = toStart[(std::size_t) (note >> 6)];
+            const std::uint64_t bit = std::uint64_t(1) << (note & 63);
+            if (word & bit)
+            {
+                word &= ~bit;
+                const auto velocity = host.chordVelocity(pitchMask, note);
+                host.writeChordNote(note, channelIndex, samplePosition);
+                notes.add(note, channelIndex, velocity);
+                notes.setVelocity(note, channelIndex, velocity);
+            }
+        }
+        host.chordWritten(pitchMask, channelIndex, samplePosition);
+        // Only the untransposed chord's prebuilt note offs release exactly this set
+        latch.latchedChord = transposed ? nullptr : &chord;
+    }
+
+    template <typename Host>
+    static bool programChange(State<Host>& state, Latch<Host>& latch, const int mappingKey, const int samplePosition, Host& host)
+    {
+        if constexpr (Mode::storesChords)
+        {
+            // The latch's notes are assigned to the program instead of being replaced
+            host.storeChord(mappingKey, state.notes.getPitchMask(latch.channels));
+            return false;
+        }
+        else
+        {
+            const auto* chord = host.findChord(mappingKey);
+            if (chord != nullptr && Transitions::minimal)
+            {
+                transitionToChord(state.notes, latch, *chord, state.sharedNotePolicy, state.transposition, samplePosition, host);
+            }
+            else
+            {
+                releaseAll(state.notes, latch, samplePosition, host);
+                if (chord != nullptr)
+                {
+                    fireChord(state.notes, latch, *chord, state.transposition, samplePosition, host);
+                }
+            }
+            latch.isRecording = false;
+            latch.chordStartTime = State<Host>::noChord;
+            latch.firedMappingKey = chord != nullptr ? mappingKey : -1;
+            host.programChanged(mappingKey, state.notes);
+            return true;
+        }
+    }
+};
@@ -0,0 +1,195 @@
+/*
+  ==============================================================================
+
+    LatchViews.cpp
+
+  ==============================================================================
+*/
+
+#include "LatchViews.h"
+#include "NoteNames.h"
+
+//==============================================================================
+bool LatchedKeyboard::isBlackKey(int note)
+{
+    const int pitchClass = note % 12;
+    return pitchClass == 1 || pitchClass == 3 || pitchClass == 6 || pitchClass == 8 || pitchClass == 10;
+}
+
+void LatchedKeyboard::setLatchedNotes(const std::array<std::uint64_t, 2>& pitchMask)
+{
+    for (size_t word = 0; word < 2; ++word)
+    {
+        std::uint64_t changed = latched[word] ^ pitchMask[word];
+        latched[word] = pitchMask[word];
+        while (changed)
+        {
+            const int note = (int) word * 64 + std::countr_zero(changed);
+            changed &= changed - 1;
+            repaint(keyBounds[(size_t) note]);
+        }
+    }
+}
+
+juce::String LatchedKeyboard::getLatchedNoteNames() const
+{
+    juce::String names = getChordName(latched);
+    if (names.isNotEmpty()) { names += " - "; }
+    const int chordNameLength = names.length();
+    for (int note = 0; note < 128; ++note)
+    {
+        if (!isLatched(note)) { continue; }
+        if (names.length() > chordNameLength) { names += ", "; }
+        names += getNoteName(note);
+    }
+    return names;
+}
+
+void LatchedKeyboard::resized()
+{
+    constexpr int numWhiteKeys = 75;
+    const float whiteWidth = (float) getWidth() / numWhiteKeys;
+    const int blackWidth = juce::roundToInt(whiteWidth * 0.6f);
+    const int blackHeight = getHeight() * 6 / 10;
+    int whiteIndex = 0;
+    for (int note = 0; note < 128; ++note)
+    {
+        if (isBlackKey(note))
+        {
+            const int centre = juce::roundToInt(whiteIndex * whiteWidth);
+            keyBounds[(size_t) note] = { centre - blackWidth / 2, 0, blackWidth, blackHeight };
+        }
+        else
+        {
+            const int left = juce::roundToInt(whiteIndex * whiteWidth);
+            const int right = juce::roundToInt((whiteIndex + 1) * whiteWidth);
+            keyBounds[(size_t) note] = { left, 0, right - left, getHeight() };
+            ++whiteIndex;
+        }
+    }
+}
+
+void LatchedKeyboard::paint (juce::Graphics& g)
+{
+    // Only keys inside the dirty region are drawn, white keys first so the black ones end up on top
+    const auto clip = g.getClipBounds();
+    for (const bool black : { false, true })
+    {
+        for (int note = 0; note < 128; ++note)
+        {
+            const auto& key = keyBounds[(size_t) note];
+            if (isBlackKey(note) != black || !key.intersects(clip)) { continue; }
+            if (isLatched(note))
+            {
+                g.setColour(juce::Colours::orange);
+            }
+            else
+            {
+                g.setColour(black ? juce::Colours::black : juce::Colours::white);
+            }
+            g.fillRect(key);
+            g.setColour(juce::Colours::darkgrey);
+            g.drawRect(key);
+        }
+    }
+}
+
+//==============================================================================
+void MappingList::setMapping(const MidiMapping& mapping, std::uint64_t version)
+{
+    if (hasShownVersion && version == shownVersion) { return; }
+    hasShownVersion = true;
+    shownVersion = version;
+
+    std::vector<Row> newRows;
+    newRows.reserve(mapping.size());
+    mapping.forEach([&newRows, &mapping](int mappingKey, const std::vector<int>& notes)
+    {
+        juce::String text;
+        // Bank 0 shows plain program change numbers, like mappings did before banks
+        if (MidiMapping::getBank(mappingKey) != 0)
+        {
+            text << MidiMapping::getBank(mappingKey) << "/";
+        }
+        text << MidiMapping::getProgram(mappingKey) << ": ";
+        const auto chordName = getChordName(mapping.find(mappingKey)->pitchMask);
+        if (chordName.isNotEmpty())
+        {
+            text << chordName << " - ";
+        }
+        bool has_previous = false;
+        for (int note : notes)
+        {
+            if (has_previous) { text << ", "; }
+            has_previous = true;
+            text << getNoteName(note);
+        }
+        newRows.push_back({ mappingKey, text });
+    });
+
+    if (newRows.size() != rows.size())
+    {
+        // Resizing repaints everything anyway
+        rows = std::move(newRows);
+        setSize(getWidth(), (int) rows.size() * rowHeight);
+        repaint();
+        return;
+    }
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        if (rows[i].mappingKey != newRows[i].mappingKey || rows[i].text != newRows[i].text)
+        {
+            rows[i] = std::move(newRows[i]);
+            repaint(getRowBounds(i));
+        }
+    }
+}
+
+void MappingList::setActiveMappingKey(int mappingKey)
+{
+    if (mappingKey == activeMappingKey) { return; }
+    repaintMappingKey(activeMappingKey);
+    activeMappingKey = mappingKey;
+    repaintMappingKey(activeMappingKey);
+}
+
+void MappingList::clearActiveMappingKey(int mappingKey)
+{
+    if (mappingKey != activeMappingKey) { return; }
+    repaintMappingKey(activeMappingKey);
+    activeMappingKey = -1;
+}
+
+void MappingList::repaintMappingKey(int mappingKey)
+{
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        if (rows[i].mappingKey == mappingKey)
+        {
+            repaint(getRowBounds(i));
+            return;
+        }
+    }
+}
+
+void MappingList::paint (juce::Graphics& g)
+{
+    const auto clip = g.getClipBounds();
+    const size_t firstRow = (size_t) juce::jmax(0, clip.getY() / rowHeight);
+    const size_t lastRow = juce::jmin(rows.size(), (size_t) (clip.getBottom() / rowHeight + 1));
+    g.setColour(findColour(juce::TextEditor::backgroundColourId));
+    g.fillRect(clip);
+    g.setFont(14.0f);
+    for (size_t i = firstRow; i < lastRow; ++i)
+    {
+        const auto bounds = getRowBounds(i);
+        const bool active = rows[i].mappingKey == activeMappingKey;
+        if (active)
+        {
+            g.setColour(juce::Colours::orange);
+            g.fillRect(bounds);
+        }
+        g.setColour(active ? juce::Colours::black : findColour(juce::TextEditor::textColourId));
+        g.drawText(rows[i].text, bounds.reduced(4, 0), juce::Justification::centredLeft, true);
+    }
+}
@@ -0,0 +1,78 @@
+/*
+  ==============================================================================
+
+    LatchViews.h
+    Custom painted views of the latched notes and the midi mapping, which only
+    repaint the keys and rows that actually changed.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "MidiMapping.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// A 128 key keyboard with the latched notes highlighted
+class LatchedKeyboard  : public juce::Component
+{
+public:
+    LatchedKeyboard() { setOpaque(true); }
+
+    // Repaints only the keys whose state differs from what is shown
+    void setLatchedNotes(const std::array<std::uint64_t, 2>& pitchMask);
+    // The chord name, if the notes form a known chord, followed by the note names
+    juce::String getLatchedNoteNames() const;
+
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+private:
+    bool isLatched(int note) const { return (latched[(size_t) (note >> 6)] >> (note & 63)) & 1; }
+    static bool isBlackKey(int note);
+
+    std::array<std::uint64_t, 2> latched {};
+    // Key rectangles, recomputed when the component is resized
+    std::array<juce::Rectangle<int>, 128> keyBounds;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LatchedKeyboard)
+};
+
+// One row per mapped bank and program, with the last fired one highlighted. A matched
+// chord is highlighted until its latch plays something else.
+class MappingList  : public juce::Component
+{
+public:
+    static constexpr int rowHeight = 18;
+
+    MappingList() { setOpaque(true); }
+
+    // Rebuilds the rows only if version differs from the one shown, and repaints
+    // only the rows whose content changed
+    void setMapping(const MidiMapping& mapping, std::uint64_t version);
+    void setActiveMappingKey(int mappingKey);
+    // Drops the highlight if it is on mappingKey
+    void clearActiveMappingKey(int mappingKey);
+
+    void paint (juce::Graphics&) override;
+
+private:
+    struct Row
+    {
+        int mappingKey;
+        juce::String text;
+    };
+
+    juce::Rectangle<int> getRowBounds(size_t row) const { return { 0, (int) row * rowHeight, getWidth(), rowHeight }; }
+    void repaintMappingKey(int mappingKey);
+
+    std::vector<Row> rows;
+    std::uint64_t shownVersion = 0;
+    bool hasShownVersion = false;
+    int activeMappingKey = -1;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MappingList)
+};
@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    MappingHistory.cpp
+
+  ==============================================================================
+*/
+
+#include "MappingHistory.h"
+
+void MappingHistory::reset(const MidiMapping& mapping)
+{
+    undoSteps.clear();
+    redoSteps.clear();
+    current = mapping;
+}
+
+void MappingHistory::push(const MidiMapping& mapping, const juce::String& description)
+{
+    undoSteps.push_back({ std::move(current), description });
+    if ((int) undoSteps.size() > maxUndoSteps)
+    {
+        undoSteps.pop_front();
+    }
+    redoSteps.clear();
+    current = mapping;
+}
+
+bool MappingHistory::undo()
+{
+    if (!canUndo()) { return false; }
+    redoSteps.push_back({ std::move(current), undoSteps.back().description });
+    current = std::move(undoSteps.back().mapping);
+    undoSteps.pop_back();
+    return true;
+}
+
+bool MappingHistory::redo()
+{
+    if (!canRedo()) { return false; }
+    undoSteps.push_back({ std::move(current), redoSteps.back().description });
+    current = std::move(redoSteps.back().mapping);
+    redoSteps.pop_back();
+    return true;
+}
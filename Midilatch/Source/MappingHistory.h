@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    MappingHistory.h
+    Undo and redo for edits to the mapping.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "MidiMapping.h"
+#include <deque>
+#include <vector>
+
+// Every step keeps a whole MidiMapping, but mappings share their pages and entries with
+// the one they were edited from, so a step costs the pages its edit copied rather than
+// a copy of every chord. The history only holds mappings, the audio thread keeps
+// playing from the snapshot MidiMappingStore gave it, so stepping through the history
+// never touches a mapping that is in use.
+//
+// Not thread safe, the owner serializes access.
+class MappingHistory
+{
+public:
+    // Older steps are forgotten beyond this
+    static constexpr int maxUndoSteps = 100;
+
+    MappingHistory() = default;
+
+    // Starts over from mapping, with nothing to undo or redo
+    void reset(const MidiMapping& mapping);
+    // Records that the mapping was changed to mapping by what description says, e.g.
+    // "Record". The previous mapping can be undone to, and the redo steps are dropped.
+    void push(const MidiMapping& mapping, const juce::String& description);
+
+    bool canUndo() const { return !undoSteps.empty(); }
+    bool canRedo() const { return !redoSteps.empty(); }
+    // What the next undo or redo reverts or repeats, empty if there is none
+    juce::String getUndoDescription() const { return canUndo() ? undoSteps.back().description : juce::String(); }
+    juce::String getRedoDescription() const { return canRedo() ? redoSteps.back().description : juce::String(); }
+
+    // Step back or forward, returning false if there is nothing to step to. getCurrent()
+    // is then the mapping to publish.
+    bool undo();
+    bool redo();
+    const MidiMapping& getCurrent() const { return current; }
+
+private:
+    struct Step
+    {
+        MidiMapping mapping;
+        // Of the change that led away from mapping
+        juce::String description;
+    };
+
+    std::deque<Step> undoSteps;
+    std::vector<Step> redoSteps;
+    MidiMapping current;
+
+    JUCE_DECLARE_NON_COPYABLE (MappingHistory)
+};
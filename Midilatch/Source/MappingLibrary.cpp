@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    MappingLibrary.cpp
+
+  ==============================================================================
+*/
+
+#include "MappingLibrary.h"
+#include <algorithm>
+
+IndexedMapping MappingLibrary::subscribe(const juce::String& name, Subscriber& subscriber, const IndexedMapping& fallback)
+{
+    const RealtimeWatchdog::ScopedLock scopedLock(lock);
+    auto found = sets.find(name);
+    if (found == sets.end())
+    {
+        found = sets.emplace(name, MappingSet { fallback, {} }).first;
+    }
+    auto& subscribers = found->second.subscribers;
+    if (std::find(subscribers.begin(), subscribers.end(), &subscriber) == subscribers.end())
+    {
+        subscribers.push_back(&subscriber);
+    }
+    return found->second.mapping;
+}
+
+void MappingLibrary::unsubscribe(const juce::String& name, Subscriber& subscriber)
+{
+    const RealtimeWatchdog::ScopedLock scopedLock(lock);
+    const auto found = sets.find(name);
+    if (found == sets.end()) { return; }
+    auto& subscribers = found->second.subscribers;
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), &subscriber), subscribers.end());
+    if (subscribers.empty())
+    {
+        sets.erase(found);
+    }
+}
+
+void MappingLibrary::publish(const juce::String& name, const IndexedMapping& mapping, Subscriber* source)
+{
+    const RealtimeWatchdog::ScopedLock scopedLock(lock);
+    const auto found = sets.find(name);
+    if (found == sets.end()) { return; }
+    found->second.mapping = mapping;
+    for (auto* subscriber : found->second.subscribers)
+    {
+        if (subscriber != source)
+        {
+            subscriber->mappingSetChanged(mapping);
+        }
+    }
+}
+
+juce::StringArray MappingLibrary::getSetNames() const
+{
+    const RealtimeWatchdog::ScopedLock scopedLock(lock);
+    juce::StringArray names;
+    for (const auto& set : sets)
+    {
+        names.add(set.first);
+    }
+    return names;
+}
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    MappingLibrary.h
+    Named mapping sets shared by all plugin instances in the process.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "MidiMapping.h"
+#include "RealtimeWatchdog.h"
+#include <map>
+
+// Instances that play from the same pedalboard map subscribe to the same named set
+// instead of each holding and parsing its own copy. Mappings share their pages, so
+// handing a set to another instance copies a page table, never the chords, and each
+// instance then swaps it in through its own MidiMappingStore. The set's ChordIndex is
+// built once by whoever publishes it and shared by all of them.
+//
+// Get hold of it through a juce::SharedResourcePointer<MappingLibrary>: the library
+// lives as long as any instance does, and a set as long as anyone subscribes to it.
+class MappingLibrary
+{
+public:
+    // Called with the set's new mapping whenever another subscriber publishes to it.
+    // Called on the publishing thread with the library locked, so it must not call
+    // back into the library.
+    struct Subscriber
+    {
+        virtual ~Subscriber() = default;
+        virtual void mappingSetChanged(const IndexedMapping& mapping) = 0;
+    };
+
+    MappingLibrary() = default;
+
+    // Subscribes to the named set, creating it from fallback if nobody has it yet.
+    // Returns the set's current mapping.
+    IndexedMapping subscribe(const juce::String& name, Subscriber& subscriber, const IndexedMapping& fallback);
+    // The set is dropped with its last subscriber
+    void unsubscribe(const juce::String& name, Subscriber& subscriber);
+    // Makes mapping the set's current one and hands it to every subscriber but source
+    void publish(const juce::String& name, const IndexedMapping& mapping, Subscriber* source);
+
+    juce::StringArray getSetNames() const;
+
+private:
+    struct MappingSet
+    {
+        IndexedMapping mapping;
+        std::vector<Subscriber*> subscribers;
+    };
+
+    RealtimeWatchdog::CriticalSection lock { "MappingLibrary::lock" };
+    std::map<juce::String, MappingSet> sets;
+
+    JUCE_DECLARE_NON_COPYABLE (MappingLibrary)
+};
@@ -0,0 +1,296 @@
+/*
+  ==============================================================================
+
+    MidiMapping.cpp
+
+  ==============================================================================
+*/
+
+#include "MidiMapping.h"
+#include "NoteNames.h"
+
+MappingEntry::MappingEntry(std::vector<int> chord) : notes(std::move(chord))
+{
+    // Mapped chords go out on channel 0, which juce::MidiMessage clamps to channel 1
+    const juce::uint8 channelNibble = 0x00;
+    for (int note : notes)
+    {
+        const juce::uint8 noteOn[] = { (juce::uint8) (0x90 | channelNibble), (juce::uint8) note, 127 };
+        noteOns.addEvent(noteOn, 3, 0);
+        pitchMask[(size_t) (note >> 6)] |= std::uint64_t(1) << (note & 63);
+    }
+    for (int note = 0; note < 128; ++note)
+    {
+        if ((pitchMask[(size_t) (note >> 6)] >> (note & 63)) & 1)
+        {
+            const juce::uint8 noteOff[] = { (juce::uint8) (0x80 | channelNibble), (juce::uint8) note, 0 };
+            noteOffs.addEvent(noteOff, 3, 0);
+        }
+    }
+}
+
+//==============================================================================
+MidiMapping::MidiMapping() : banks()
+{
+}
+
+void MidiMapping::assign(const int key, std::vector<int> notes)
+{
+    jassert (key >= 0 && key < numKeys);
+    // Copy the pages on the path to the slot, everything else stays shared
+    const auto& oldBankGroup = banks[(size_t) (key >> 14)];
+    auto bankGroup = oldBankGroup != nullptr ? std::make_shared<BankGroup>(*oldBankGroup) : std::make_shared<BankGroup>();
+    const auto& oldPage = bankGroup->pages[(size_t) ((key >> 7) & 127)];
+    auto page = oldPage != nullptr ? std::make_shared<ProgramPage>(*oldPage) : std::make_shared<ProgramPage>();
+    auto& entry = page->entries[(size_t) (key & 127)];
+    if (entry == nullptr) { ++numEntries; }
+    entry = std::make_shared<const MappingEntry>(std::move(notes));
+    bankGroup->pages[(size_t) ((key >> 7) & 127)] = std::move(page);
+    banks[(size_t) (key >> 14)] = std::move(bankGroup);
+}
+
+const std::vector<int>& MidiMapping::getNotes(const int key) const
+{
+    static const std::vector<int> noNotes;
+    const auto* entry = find(key);
+    if (entry == nullptr)
+    {
+        return noNotes;
+    }
+    return entry->notes;
+}
+
+const std::string MidiMapping::getDisplayText() const
+{
+    std::stringstream stream;
+    forEach([this, &stream](int key, const std::vector<int>& notes)
+    {
+        stream << key << ": ";
+        const auto chordName = ChordNames::getName(find(key)->pitchMask);
+        if (!chordName.empty())
+        {
+            stream << chordName << " - ";
+        }
+        bool has_previous = false;
+        for (int note : notes)
+        {
+            if (has_previous) { stream << ", "; }
+            has_previous = true;
+            stream << getNoteName(note);
+        }
+        stream << "\n";
+    });
+    return stream.str();
+}
+
+const std::string MidiMapping::getStringSerialization() const
+{
+    std::stringstream stream;
+    forEach([&stream](int key, const std::vector<int>& notes)
+    {
+        stream << key << ':';
+        for (int note : notes)
+        {
+            stream << note << ',';
+        }
+        stream << ';';
+    });
+    return stream.str();
+}
+
+juce::Result MidiMapping::parseStringSerialization(const std::string& text)
+{
+    // Single pass over the text, the mapping is only replaced if all of it parses
+    MidiMapping parsed;
+    int curKey = -1;
+    std::vector<int> curValues;
+    int value = 0;
+    bool hasValue = false;
+    for (const char c : text)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            value = value * 10 + (c - '0');
+            hasValue = true;
+            if (value >= numKeys)
+            {
+                return juce::Result::fail("Number out of range in midi mapping");
+            }
+        }
+        else if (c == ':')
+        {
+            if (!hasValue)
+            {
+                return juce::Result::fail("Missing program change number in midi mapping");
+            }
+            curKey = value;
+            value = 0;
+            hasValue = false;
+        }
+        else if (c == ',' || c == ';')
+        {
+            if (hasValue)
+            {
+                if (value > 127)
+                {
+                    return juce::Result::fail("Note out of range in midi mapping");
+                }
+                curValues.push_back(value);
+            }
+            else if (c == ',')
+            {
+                return juce::Result::fail("Missing note number in midi mapping");
+            }
+            value = 0;
+            hasValue = false;
+            if (c == ';')
+            {
+                if (curKey < 0)
+                {
+                    return juce::Result::fail("Chord without a program change number in midi mapping");
+                }
+                parsed.assign(curKey, curValues);
+                curValues.clear();
+            }
+        }
+        else if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+        {
+            return juce::Result::fail("Unexpected character in midi mapping");
+        }
+    }
+    if (hasValue || !curValues.empty())
+    {
+        return juce::Result::fail("Midi mapping does not end with a ';'");
+    }
+    *this = std::move(parsed);
+    return juce::Result::ok();
+}
+
+void MidiMapping::shareUnchangedWith(const MidiMapping& other)
+{
+    for (size_t msb = 0; msb < banks.size(); ++msb)
+    {
+        const auto& otherBankGroup = other.banks[msb];
+        if (banks[msb] == nullptr || otherBankGroup == nullptr || banks[msb] == otherBankGroup) { continue; }
+        auto bankGroup = std::make_shared<BankGroup>(*banks[msb]);
+        bool sameBankGroup = true;
+        for (size_t lsb = 0; lsb < 128; ++lsb)
+        {
+            auto& page = bankGroup->pages[lsb];
+            const auto& otherPage = otherBankGroup->pages[lsb];
+            if (page != nullptr && otherPage != nullptr && page != otherPage)
+            {
+                auto sharedPage = std::make_shared<ProgramPage>(*page);
+                bool samePage = true;
+                for (size_t program = 0; program < 128; ++program)
+                {
+                    auto& entry = sharedPage->entries[program];
+                    const auto& otherEntry = otherPage->entries[program];
+                    if (entry != nullptr && otherEntry != nullptr && entry->notes == otherEntry->notes)
+                    {
+                        entry = otherEntry;
+                    }
+                    samePage = samePage && entry == otherEntry;
+                }
+                page = samePage ? otherPage : std::shared_ptr<const ProgramPage>(std::move(sharedPage));
+            }
+            sameBankGroup = sameBankGroup && page == otherPage;
+        }
+        banks[msb] = sameBankGroup ? otherBankGroup : std::shared_ptr<const BankGroup>(std::move(bankGroup));
+    }
+}
+
+//==============================================================================
+MidiMappingStore::MidiMappingStore()
+{
+    snapshots.push_back(std::make_unique<Snapshot>(MidiMapping(), nullptr, nextVersion++));
+    current.store(snapshots.back().get());
+    acknowledgedVersion.store(snapshots.back()->version);
+    audioThreadSnapshot = snapshots.back().get();
+}
+
+const MidiMapping& MidiMappingStore::get() const
+{
+    return current.load()->mapping;
+}
+
+void MidiMappingStore::publish(MidiMapping newMapping, std::shared_ptr<const ChordIndex> chordIndex)
+{
+    const RealtimeWatchdog::ScopedLock lock(writerLock);
+    publishLocked(std::move(newMapping), std::move(chordIndex));
+}
+
+void MidiMappingStore::publishSharingUnchanged(MidiMapping newMapping)
+{
+    const RealtimeWatchdog::ScopedLock lock(writerLock);
+    newMapping.shareUnchangedWith(current.load()->mapping);
+    publishLocked(std::move(newMapping));
+}
+
+void MidiMappingStore::publishLocked(MidiMapping newMapping, std::shared_ptr<const ChordIndex> chordIndex)
+{
+    snapshots.push_back(std::make_unique<Snapshot>(std::move(newMapping), std::move(chordIndex), nextVersion++));
+    current.store(snapshots.back().get());
+}
+
+bool MidiMappingStore::applyStoredChords()
+{
+    const int numReady = storedChordFifo.getNumReady();
+    if (numReady == 0) { return false; }
+
+    int start1, size1, start2, size2;
+    storedChordFifo.prepareToRead(numReady, start1, size1, start2, size2);
+    MidiMapping copy = current.load()->mapping;
+    const auto assignRange = [this, &copy](int start, int size)
+    {
+        for (int i = start; i < start + size; ++i)
+        {
+            const auto& chord = storedChords[(size_t) i];
+            copy.assign(chord.mappingKey, std::vector<int>(chord.notes.begin(), chord.notes.begin() + chord.numNotes));
+        }
+    };
+    assignRange(start1, size1);
+    assignRange(start2, size2);
+    storedChordFifo.finishedRead(size1 + size2);
+    publishLocked(std::move(copy));
+    return true;
+}
+
+bool MidiMappingStore::collectGarbage()
+{
+    const RealtimeWatchdog::ScopedLock lock(writerLock);
+    const bool appliedStoredChords = applyStoredChords();
+
+    // The audio thread only ever moves forward to the newest snapshot, so everything
+    // older than the version it acknowledged can go. A stopped audio thread holds none,
+    // and starts again from the newest.
+    const auto* newest = current.load();
+    const auto inUse = audioThreadIdle.load() ? newest->version : acknowledgedVersion.load();
+    snapshots.erase(std::remove_if(snapshots.begin(), snapshots.end(), [inUse, newest](const auto& snapshot)
+    {
+        return snapshot.get() != newest && snapshot->version < inUse;
+    }), snapshots.end());
+    return appliedStoredChords;
+}
+
+const MidiMapping& MidiMappingStore::acquire()
+{
+    const auto* snapshot = current.load(std::memory_order_acquire);
+    if (snapshot->version != audioThreadVersion)
+    {
+        audioThreadVersion = snapshot->version;
+        audioThreadSnapshot = snapshot;
+        acknowledgedVersion.store(audioThreadVersion, std::memory_order_release);
+    }
+    return snapshot->mapping;
+}
+
+bool MidiMappingStore::pushStoredChord(const StoredChord& chord)
+{
+    int start1, size1, start2, size2;
+    storedChordFifo.prepareToWrite(1, start1, size1, start2, size2);
+    if (size1 + size2 == 0) { return false; }
+    storedChords[(size_t) (size1 > 0 ? start1 : start2)] = chord;
+    storedChordFifo.finishedWrite(1);
+    return true;
+}
@@ -0,0 +1,253 @@
+/*
+  ==============================================================================
+
+    MidiMapping.h
+    The program change to chord mapping, and the store that hands immutable
+    snapshots of it to the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChordIndex.h"
+#include "RealtimeWatchdog.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// A mapped chord, with the midi events for playing and releasing it serialized
+// ahead of time so the audio thread only has to copy them into its output
+struct MappingEntry
+{
+    explicit MappingEntry(std::vector<int> notes);
+
+    std::vector<int> notes;
+    // Note ons in the order of notes (duplicates included) on the mapping output
+    // channel with full velocity, all at sample 0
+    juce::MidiBuffer noteOns;
+    // Note offs releasing exactly this chord, in the order the latched set would release it
+    juce::MidiBuffer noteOffs;
+    // One bit per midi note in the chord
+    std::array<std::uint64_t, 2> pitchMask {};
+};
+
+// Maps a bank select (CC0/CC32) plus program change number to a chord.
+//
+// Keys are bank * 128 + program, so bank 0 keys are plain program change numbers as in
+// older mappings. The table covers all 16384 x 128 slots in three levels of 128 wide
+// pages (bank MSB, bank LSB, program), allocated only where something is mapped, so a
+// lookup is three array reads. Pages and entries are immutable once built and shared
+// between copies, an edit only copies the pages on the path to the changed slot.
+class MidiMapping
+{
+public:
+    static constexpr int numBanks = 128 * 128;
+    static constexpr int numKeys = numBanks * 128;
+
+    static int makeKey(const int bank, const int program) { return bank * 128 + program; }
+    static int getBank(const int key) { return key >> 7; }
+    static int getProgram(const int key) { return key & 127; }
+
+    MidiMapping();
+    
+    void assign(const int key, std::vector<int> notes);
+    const bool contains(const int key) const { return find(key) != nullptr; }
+    // Audio thread safe, returns nullptr if nothing is mapped to key
+    const MappingEntry* find(const int key) const
+    {
+        if (key < 0 || key >= numKeys) { return nullptr; }
+        const auto* bankGroup = banks[(size_t) (key >> 14)].get();
+        if (bankGroup == nullptr) { return nullptr; }
+        const auto* page = bankGroup->pages[(size_t) ((key >> 7) & 127)].get();
+        if (page == nullptr) { return nullptr; }
+        return page->entries[(size_t) (key & 127)].get();
+    }
+    const std::vector<int>& getNotes(const int key) const;
+    const std::string getDisplayText() const;
+    const std::string getStringSerialization() const;
+    // Leaves the mapping untouched if text is malformed
+    juce::Result parseStringSerialization(const std::string& text);
+    // Swaps in other's pages and entries wherever they hold the same chords, so a
+    // mapping built from scratch (imported, loaded) shares everything it did not change
+    // with the one it replaces, the same as if it had been edited from it
+    void shareUnchangedWith(const MidiMapping& other);
+    // True if both are one and the same mapping, as after shareUnchangedWith between
+    // equal mappings. Compares page pointers, not chords.
+    bool sharesAllPagesWith(const MidiMapping& other) const { return banks == other.banks; }
+    const std::size_t size() const { return numEntries;}
+    // Calls fn(key, notes) for every mapping, ordered by key
+    template <typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (size_t msb = 0; msb < banks.size(); ++msb)
+        {
+            if (banks[msb] == nullptr) { continue; }
+            for (size_t lsb = 0; lsb < 128; ++lsb)
+            {
+                const auto* page = banks[msb]->pages[lsb].get();
+                if (page == nullptr) { continue; }
+                for (size_t program = 0; program < 128; ++program)
+                {
+                    if (const auto* entry = page->entries[program].get())
+                    {
+                        fn((int) ((msb << 14) | (lsb << 7) | program), entry->notes);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    struct ProgramPage
+    {
+        std::array<std::shared_ptr<const MappingEntry>, 128> entries;
+    };
+    struct BankGroup
+    {
+        std::array<std::shared_ptr<const ProgramPage>, 128> pages;
+    };
+
+    // Indexed by bank MSB
+    std::array<std::shared_ptr<const BankGroup>, 128> banks;
+    std::size_t numEntries = 0;
+};
+
+
+// A mapping with its reverse index, as handed from one store to another
+struct IndexedMapping
+{
+    MidiMapping mapping;
+    std::shared_ptr<const ChordIndex> chordIndex;
+};
+
+// Owns every published MidiMapping and hands the newest one to the audio thread.
+//
+// A published snapshot is never modified again. Edits from the message thread (or
+// whichever thread the host calls setStateInformation on) copy the current mapping,
+// change the copy and publish it with a single atomic pointer store. The audio thread
+// picks up the newest snapshot with one atomic load per block and acknowledges the
+// version it is using, and snapshots older than that are freed later from
+// collectGarbage() on the message thread, never from the audio thread.
+//
+// Every snapshot comes with the ChordIndex of its mapping, built when it is published
+// unless the publisher hands over the one it already has.
+//
+// The audio thread cannot edit a snapshot, so chords stored in Record mode are pushed
+// into a wait-free single producer / single consumer queue instead and applied by
+// collectGarbage().
+class MidiMappingStore
+{
+public:
+    // A chord recorded on the audio thread, waiting to be assigned to a mapping key
+    struct StoredChord
+    {
+        static constexpr int maxNotes = 16 * 128;
+
+        int mappingKey = 0;
+        int numNotes = 0;
+        std::array<juce::uint8, maxNotes> notes {};
+    };
+
+    MidiMappingStore();
+
+    //==============================================================================
+    // Any thread but the audio thread
+
+    // The most recently published mapping. Stays valid until the next publish.
+    const MidiMapping& get() const;
+    const ChordIndex& getChordIndex() const { return *current.load()->chordIndex; }
+    // The most recently published mapping and its index, from the same snapshot
+    IndexedMapping getIndexed() const
+    {
+        const auto* snapshot = current.load();
+        return { snapshot->mapping, snapshot->chordIndex };
+    }
+    // Increases with every publish, so readers can tell whether they are out of date
+    std::uint64_t getVersion() const { return current.load()->version; }
+    // The most recently published mapping and its version, read together so they
+    // always belong to the same publish
+    struct Versioned
+    {
+        const MidiMapping& mapping;
+        std::uint64_t version;
+    };
+    Versioned getVersioned() const
+    {
+        const auto* snapshot = current.load();
+        return { snapshot->mapping, snapshot->version };
+    }
+    // chordIndex, if given, has to be the index of newMapping, as another store built it
+    void publish(MidiMapping newMapping, std::shared_ptr<const ChordIndex> chordIndex = {});
+    // Publishes newMapping after letting it share the pages it has in common with the
+    // current mapping (see MidiMapping::shareUnchangedWith). Both happen under the
+    // writer lock, so no other publish or collectGarbage frees the current mapping
+    // while it is being compared.
+    void publishSharingUnchanged(MidiMapping newMapping);
+    // Copies the current mapping, lets fn edit the copy and publishes the result
+    template <typename Fn>
+    void modify(Fn&& fn)
+    {
+        const RealtimeWatchdog::ScopedLock lock(writerLock);
+        MidiMapping copy = current.load()->mapping;
+        fn(copy);
+        publishLocked(std::move(copy));
+    }
+    // Applies chords stored by the audio thread and frees snapshots it no longer uses.
+    // Called periodically from the message thread. Returns true if stored chords were
+    // applied, i.e. a new mapping was published.
+    bool collectGarbage();
+    // Whether the audio thread is stopped (before prepareToPlay and after
+    // releaseResources). It acknowledges nothing then, so collectGarbage keeps only the
+    // newest snapshot instead of every one published since the audio thread last ran.
+    void setAudioThreadIdle(bool isIdle) { audioThreadIdle.store(isIdle); }
+
+    //==============================================================================
+    // Audio thread only
+
+    // The newest published mapping, valid until the next call
+    const MidiMapping& acquire();
+    // The reverse index of the mapping acquire() returned
+    const ChordIndex& getAcquiredChordIndex() const { return *audioThreadSnapshot->chordIndex; }
+    // Wait-free, returns false if the queue is full and the chord was dropped
+    bool pushStoredChord(const StoredChord& chord);
+
+private:
+    struct Snapshot
+    {
+        Snapshot(MidiMapping newMapping, std::shared_ptr<const ChordIndex> index, std::uint64_t newVersion)
+            : mapping(std::move(newMapping)),
+              chordIndex(index != nullptr ? std::move(index) : std::make_shared<const ChordIndex>(mapping)),
+              version(newVersion) {}
+
+        MidiMapping mapping;
+        // Shared with the stores of other instances subscribed to the same set
+        std::shared_ptr<const ChordIndex> chordIndex;
+        std::uint64_t version;
+    };
+
+    void publishLocked(MidiMapping newMapping, std::shared_ptr<const ChordIndex> chordIndex = {});
+    bool applyStoredChords();
+
+    static constexpr int storedChordQueueSize = 8;
+
+    // Guards snapshots and nextVersion against concurrent writers, never taken by the audio thread
+    RealtimeWatchdog::CriticalSection writerLock { "MidiMappingStore::writerLock" };
+    std::vector<std::unique_ptr<Snapshot>> snapshots;
+    std::uint64_t nextVersion = 0;
+
+    std::atomic<Snapshot*> current;
+    std::atomic<std::uint64_t> acknowledgedVersion;
+    std::atomic<bool> audioThreadIdle { true };
+    // Only touched by the audio thread
+    std::uint64_t audioThreadVersion = 0;
+    const Snapshot* audioThreadSnapshot = nullptr;
+
+    juce::AbstractFifo storedChordFifo { storedChordQueueSize };
+    std::array<StoredChord, storedChordQueueSize> storedChords;
+
+    JUCE_DECLARE_NON_COPYABLE (MidiMappingStore)
+};
@@ -0,0 +1,37 @@
+/*
+  ==============================================================================
+
+    NoteNames.h
+    Note names for all 128 midi notes, built once instead of on every lookup,
+    and chord names as juce::Strings.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChordNames.h"
+#include <array>
+#include <cstdint>
+
+// Same naming as juce::MidiMessage::getMidiNoteName(note, true, true, 4), i.e. "C#3"
+inline const juce::String& getNoteName(const int note)
+{
+    static const std::array<juce::String, 128> names = []
+    {
+        std::array<juce::String, 128> table;
+        for (int i = 0; i < 128; ++i)
+        {
+            table[(size_t) i] = juce::MidiMessage::getMidiNoteName(i, true, true, 4);
+        }
+        return table;
+    }();
+    return names[(size_t) (note & 127)];
+}
+
+// E.g. "Cmaj7" or "Am/C", empty if the notes do not form a known chord. See ChordNames.
+inline juce::String getChordName(const std::array<std::uint64_t, 2>& pitchMask)
+{
+    return juce::String(ChordNames::getName(pitchMask));
+}
@@ -0,0 +1,209 @@
+/*
+  ==============================================================================
+
+    OutputScheduler.cpp
+
+  ==============================================================================
+*/
+
+#include "OutputScheduler.h"
+
+namespace
+{
+    bool isNoteOff(const juce::uint8* data, int size)
+    {
+        return size == 3 && ((data[0] & 0xf0) == 0x80 || ((data[0] & 0xf0) == 0x90 && data[2] == 0));
+    }
+
+    bool isNoteOn(const juce::uint8* data, int size)
+    {
+        return size == 3 && (data[0] & 0xf0) == 0x90 && data[2] != 0;
+    }
+
+    int toSamplePosition(double sendTime, juce::int64 blockStart, int numSamples)
+    {
+        return juce::jlimit(0, juce::jmax(0, numSamples - 1), (int) (sendTime - (double) blockStart));
+    }
+}
+
+void OutputScheduler::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    // Samples count from 0 again, pending note offs are due right away
+    for (int i = 0; i < noteOffs.count; ++i)
+    {
+        noteOffs.at(i).requestedSample = 0;
+    }
+    others.clear();
+    longMessagesHead = 0;
+    longMessagesSize = 0;
+    pendingCount = noteOffs.count;
+    pendingNoteOns = {};
+    wireFreeAt = 0.0;
+    lastSentAt = 0.0;
+    queueDepth.store(pendingCount);
+    addedLatencyMs.store(0.0);
+    maxAddedLatencyMs.store(0.0);
+}
+
+bool OutputScheduler::cancelPendingNoteOns(juce::uint8 channel, juce::uint8 note)
+{
+    if (pendingNoteOns[channel][note] == 0) { return false; }
+    // One note off ends the note however often it was started, so every pending start goes
+    for (int i = others.count - 1; i >= 0 && pendingNoteOns[channel][note] > 0; --i)
+    {
+        auto& event = others.at(i);
+        if (event.size != 0 && isNoteOn(event.bytes, event.size) && (event.bytes[0] & 0x0f) == channel && event.bytes[1] == note)
+        {
+            event.size = 0;
+            --pendingNoteOns[channel][note];
+        }
+    }
+    // A note that already sounds still needs its note off
+    return !sounding[channel][note];
+}
+
+double OutputScheduler::getPortFree() const
+{
+    return bytesPerSecond.load(std::memory_order_relaxed) > 0 ? wireFreeAt : 0.0;
+}
+
+void OutputScheduler::occupyPort(double sendTime, int size)
+{
+    const double rate = (double) bytesPerSecond.load(std::memory_order_relaxed);
+    if (rate > 0.0)
+    {
+        wireFreeAt = juce::jmax(wireFreeAt, sendTime) + size * sampleRate / rate;
+    }
+    lastSentAt = sendTime;
+}
+
+OutputScheduler::Queue* OutputScheduler::getNextQueue(double portFree)
+{
+    // Drop cancelled events from the front
+    while (!others.isEmpty() && others.front().size == 0)
+    {
+        others.pop();
+        --pendingCount;
+    }
+    if (noteOffs.isEmpty()) { return others.isEmpty() ? nullptr : &others; }
+    if (others.isEmpty()) { return &noteOffs; }
+    // Note offs go first whenever the port is busy past both candidates anyway
+    const double othersReady = juce::jmax(portFree, (double) others.front().requestedSample);
+    return (double) noteOffs.front().requestedSample <= othersReady ? &noteOffs : &others;
+}
+
+void OutputScheduler::sendNext(Queue& queue, double sendTime, bool paced, juce::MidiBuffer& output, juce::int64 blockStart, int numSamples)
+{
+    const auto& event = queue.front();
+    const int samplePosition = toSamplePosition(sendTime, blockStart, numSamples);
+    if (event.size <= 3)
+    {
+        output.addEvent(event.bytes, event.size, samplePosition);
+    }
+    else if (event.longMessageStart + event.size <= longMessageCapacity)
+    {
+        output.addEvent(longMessages.data() + event.longMessageStart, event.size, samplePosition);
+    }
+    else
+    {
+        const int firstPart = longMessageCapacity - event.longMessageStart;
+        std::copy(longMessages.begin() + event.longMessageStart, longMessages.end(), longMessageScratch.begin());
+        std::copy(longMessages.begin(), longMessages.begin() + (event.size - firstPart), longMessageScratch.begin() + firstPart);
+        output.addEvent(longMessageScratch.data(), event.size, samplePosition);
+    }
+
+    if (paced) { occupyPort(sendTime, event.size); }
+    else { lastSentAt = sendTime; }
+    const double latencyMs = (sendTime - (double) event.requestedSample) * 1000.0 / sampleRate;
+    addedLatencyMs.store(latencyMs, std::memory_order_relaxed);
+    if (latencyMs > maxAddedLatencyMs.load(std::memory_order_relaxed))
+    {
+        maxAddedLatencyMs.store(latencyMs, std::memory_order_relaxed);
+    }
+
+    if (isNoteOn(event.bytes, event.size))
+    {
+        --pendingNoteOns[event.bytes[0] & 0x0f][event.bytes[1]];
+        sounding[event.bytes[0] & 0x0f][event.bytes[1]] = true;
+    }
+    else if (isNoteOff(event.bytes, event.size))
+    {
+        sounding[event.bytes[0] & 0x0f][event.bytes[1]] = false;
+    }
+    if (event.size > 3)
+    {
+        longMessagesHead = (longMessagesHead + event.size) % longMessageCapacity;
+        longMessagesSize -= event.size;
+    }
+    queue.pop();
+    --pendingCount;
+}
+
+void OutputScheduler::schedule(const juce::uint8* data, int size, juce::int64 requestedSample, juce::MidiBuffer& output, juce::int64 blockStart, int numSamples)
+{
+    if (isNoteOff(data, size) && cancelPendingNoteOns(data[0] & 0x0f, data[1]))
+    {
+        return;
+    }
+
+    const bool isLong = size > 3;
+    auto& queue = isNoteOff(data, size) ? noteOffs : others;
+    const auto isFull = [&] { return queue.isFull() || (isLong && longMessagesSize + size > longMessageCapacity); };
+    // Rather early than lost or out of order: what is pending goes out now, unpaced,
+    // until the event fits. The port is not charged for it, so later events are not
+    // held back by a backlog that was never paced.
+    const double now = juce::jmax(lastSentAt, (double) requestedSample);
+    while (isFull())
+    {
+        auto* next = getNextQueue(getPortFree());
+        if (next == nullptr) { break; }
+        sendNext(*next, now, false, output, blockStart, numSamples);
+    }
+    if (isFull())
+    {
+        // Only a long message bigger than the whole buffer gets here, after everything
+        // before it was sent
+        output.addEvent(data, size, toSamplePosition(now, blockStart, numSamples));
+        lastSentAt = now;
+        return;
+    }
+
+    Event event { requestedSample, { 0, 0, 0 }, size, 0 };
+    if (isLong)
+    {
+        event.longMessageStart = (longMessagesHead + longMessagesSize) % longMessageCapacity;
+        for (int i = 0; i < size; ++i)
+        {
+            longMessages[(size_t) ((event.longMessageStart + i) % longMessageCapacity)] = data[i];
+        }
+        longMessagesSize += size;
+    }
+    else
+    {
+        std::copy(data, data + size, event.bytes);
+    }
+    queue.push(event);
+    ++pendingCount;
+    if (isNoteOn(data, size))
+    {
+        ++pendingNoteOns[data[0] & 0x0f][data[1]];
+    }
+}
+
+void OutputScheduler::process(const juce::MidiBuffer& input, juce::MidiBuffer& output, juce::int64 blockStart, int numSamples)
+{
+    for (const auto metadata : input)
+    {
+        schedule(metadata.data, metadata.numBytes, blockStart + metadata.samplePosition, output, blockStart, numSamples);
+    }
+
+    const juce::int64 blockEnd = blockStart + juce::jmax(1, numSamples);
+    while (auto* queue = getNextQueue(getPortFree()))
+    {
+        const double sendTime = juce::jmax(getPortFree(), (double) queue->front().requestedSample, (double) blockStart, lastSentAt);
+        if (sendTime >= (double) blockEnd) { break; }
+        sendNext(*queue, sendTime, true, output, blockStart, numSamples);
+    }
+    queueDepth.store(pendingCount, std::memory_order_relaxed);
+}
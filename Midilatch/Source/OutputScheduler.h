@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+
+    OutputScheduler.h
+    Paces the plugin's midi output to the bandwidth of a hardware midi port,
+    carrying events that don't fit over to the following blocks.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+// A chord change produces all its note offs and note ons at the same sample, which a
+// 31.25 kbaud DIN port needs about a millisecond per note to get through. The scheduler
+// spreads such bursts out so that no more than the configured bytes per second leave
+// the plugin, sample accurately and across block boundaries.
+//
+// Pending note offs always go out before pending note ons. A note off for a note whose
+// note on is still waiting cancels both, so nothing is sent for a note that would have
+// been released before it started. Everything else, sysex included, leaves in the order
+// it came in. Queues are fixed size and the audio thread never allocates; if one fills
+// up, the oldest pending events are sent right away, unpaced, to make room, so nothing
+// is dropped or overtaken and no note can get stuck.
+class OutputScheduler
+{
+public:
+    static constexpr int capacity = 4096;
+    // Bytes of pending sysex and other long messages
+    static constexpr int longMessageCapacity = 16384;
+    // 31250 baud with 10 bits on the wire per byte
+    static constexpr int dinMidiBytesPerSecond = 3125;
+
+    // Audio thread, or while it is stopped. Starts a new time base. Pending note offs
+    // are kept and go out at the start of the next block, so their notes don't get
+    // stuck; anything else still pending is dropped.
+    void prepare(double newSampleRate);
+
+    // Any thread. 0 disables pacing.
+    void setBytesPerSecond(int newBytesPerSecond) { bytesPerSecond.store(newBytesPerSecond); }
+    int getBytesPerSecond() const { return bytesPerSecond.load(); }
+
+    // Audio thread. True if events have to go through process() this block.
+    bool isActive() const { return bytesPerSecond.load(std::memory_order_relaxed) > 0 || pendingCount > 0; }
+    // Queues every event of input, timed relative to blockStart (in samples since
+    // prepare), and writes everything that is due within this block to output
+    void process(const juce::MidiBuffer& input, juce::MidiBuffer& output, juce::int64 blockStart, int numSamples);
+
+    // Any thread
+    int getQueueDepth() const { return queueDepth.load(); }
+    // How late the most recently sent event left compared to when it was produced
+    double getAddedLatencyMs() const { return addedLatencyMs.load(); }
+    double getMaxAddedLatencyMs() const { return maxAddedLatencyMs.load(); }
+
+private:
+    struct Event
+    {
+        juce::int64 requestedSample;
+        // Messages of up to 3 bytes are kept here, longer ones in longMessages
+        juce::uint8 bytes[3];
+        // 0 marks an event that was cancelled while queued
+        int size;
+        int longMessageStart;
+    };
+
+    // Fixed size FIFO
+    struct Queue
+    {
+        bool isEmpty() const { return count == 0; }
+        bool isFull() const { return count == capacity; }
+        Event& front() { return events[(size_t) head]; }
+        Event& at(int index) { return events[(size_t) ((head + index) % capacity)]; }
+        void push(const Event& event) { events[(size_t) ((head + count) % capacity)] = event; ++count; }
+        void pop() { head = (head + 1) % capacity; --count; }
+        void clear() { head = 0; count = 0; }
+
+        std::array<Event, capacity> events;
+        int head = 0;
+        int count = 0;
+    };
+
+    void schedule(const juce::uint8* data, int size, juce::int64 requestedSample, juce::MidiBuffer& output, juce::int64 blockStart, int numSamples);
+    // Cancels the note's pending note ons, returns true if its note off is not needed
+    bool cancelPendingNoteOns(juce::uint8 channel, juce::uint8 note);
+    // When the port can take the next event, in samples
+    double getPortFree() const;
+    void occupyPort(double sendTime, int size);
+    // The queue the next event to send is at the front of, nullptr if nothing is pending
+    Queue* getNextQueue(double portFree);
+    // Unpaced sends don't occupy the port
+    void sendNext(Queue& queue, double sendTime, bool paced, juce::MidiBuffer& output, juce::int64 blockStart, int numSamples);
+
+    std::atomic<int> bytesPerSecond { 0 };
+    double sampleRate = 44100.0;
+
+    Queue noteOffs;
+    Queue others;
+    int pendingCount = 0;
+    // Ring buffer holding the bytes of the long messages in others, in queue order
+    std::array<juce::uint8, longMessageCapacity> longMessages;
+    int longMessagesHead = 0;
+    int longMessagesSize = 0;
+    // For sending a long message that wraps around the end of longMessages
+    std::array<juce::uint8, longMessageCapacity> longMessageScratch;
+    // Number of note ons per channel/note waiting in others, to find cancellations quickly
+    std::array<std::array<juce::uint16, 128>, 16> pendingNoteOns {};
+    // Whether the last note on or off sent for a channel/note was a note on
+    std::array<std::array<bool, 128>, 16> sounding {};
+    // Time in samples at which the port is done with everything sent so far
+    double wireFreeAt = 0.0;
+    // Nothing is sent before what was sent last, paced or not
+    double lastSentAt = 0.0;
+
+    std::atomic<int> queueDepth { 0 };
+    std::atomic<double> addedLatencyMs { 0.0 };
+    std::atomic<double> maxAddedLatencyMs { 0.0 };
+};
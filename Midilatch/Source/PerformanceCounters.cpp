@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+
+    PerformanceCounters.cpp
+
+  ==============================================================================
+*/
+
+#include "PerformanceCounters.h"
+
+PerformanceCounters::Snapshot PerformanceCounters::getSnapshot() const
+{
+    Snapshot snapshot;
+    snapshot.blocks = blocks.load();
+    snapshot.eventsIn = eventsIn.load();
+    snapshot.eventsOut = eventsOut.load();
+    snapshot.totalNs = totalNs.load();
+    snapshot.worstBlockNs = worstBlockNs.load();
+    snapshot.mostEventsInPerBlock = mostEventsInPerBlock.load();
+    snapshot.mostEventsOutPerBlock = mostEventsOutPerBlock.load();
+    snapshot.latchedNotesHighWater = latchedNotesHighWater.load();
+    snapshot.programChangeHits = programChangeHits.load();
+    snapshot.programChangeMisses = programChangeMisses.load();
+    snapshot.droppedNotifications = droppedNotifications.load();
+    snapshot.droppedRecordedChords = droppedRecordedChords.load();
+    for (size_t bin = 0; bin < blockTimeHistogram.size(); ++bin)
+    {
+        snapshot.blockTimeHistogram[bin] = blockTimeHistogram[bin].load();
+    }
+    return snapshot;
+}
+
+void PerformanceCounters::clear()
+{
+    for (auto* counter : { &blocks, &eventsIn, &eventsOut, &totalNs, &worstBlockNs, &mostEventsInPerBlock, &mostEventsOutPerBlock,
+                           &latchedNotesHighWater, &programChangeHits, &programChangeMisses, &droppedNotifications,
+                           &droppedRecordedChords })
+    {
+        counter->store(0, std::memory_order_relaxed);
+    }
+    for (auto& bin : blockTimeHistogram)
+    {
+        bin.store(0, std::memory_order_relaxed);
+    }
+}
+
+juce::String PerformanceCounters::Snapshot::toText() const
+{
+    juce::String text;
+    text << "blocks " << juce::String(blocks) << "\n"
+         << "events_in " << juce::String(eventsIn) << "\n"
+         << "events_out " << juce::String(eventsOut) << "\n"
+         << "max_events_in_per_block " << juce::String(mostEventsInPerBlock) << "\n"
+         << "max_events_out_per_block " << juce::String(mostEventsOutPerBlock) << "\n"
+         << "average_block_ns " << juce::String(getAverageBlockNs(), 1) << "\n"
+         << "worst_block_ns " << juce::String(worstBlockNs) << "\n"
+         << "ns_per_event " << juce::String(getNsPerEvent(), 1) << "\n"
+         << "latched_notes_high_water " << juce::String(latchedNotesHighWater) << "\n"
+         << "program_change_hits " << juce::String(programChangeHits) << "\n"
+         << "program_change_misses " << juce::String(programChangeMisses) << "\n"
+         << "dropped_notifications " << juce::String(droppedNotifications) << "\n"
+         << "dropped_recorded_chords " << juce::String(droppedRecordedChords) << "\n";
+    juce::int64 limitNs = firstBinLimitNs;
+    for (size_t bin = 0; bin < blockTimeHistogram.size(); ++bin, limitNs *= 2)
+    {
+        // The last bin has no upper limit
+        const juce::String limit = bin + 1 < blockTimeHistogram.size() ? juce::String(limitNs) : juce::String("inf");
+        text << "block_ns_below_" << limit << " " << juce::String(blockTimeHistogram[bin]) << "\n";
+    }
+    return text;
+}
@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    PerformanceCounters.h
+    What processBlock costs and does, measured by the processor itself so it can
+    be read from a headless host, the editor's stats panel or monitoring scripts.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+// Written by the audio thread only (so plain loads and stores are enough), read from
+// any thread. Each counter is consistent on its own; a snapshot taken while a block
+// finishes may mix values from two consecutive blocks.
+class PerformanceCounters
+{
+public:
+    // Block durations are binned by powers of two: bin 0 holds everything below
+    // 512 ns, bin i everything below 512 ns * 2^i, the last bin everything longer
+    static constexpr int numHistogramBins = 16;
+    static constexpr juce::int64 firstBinLimitNs = 512;
+
+    struct Snapshot
+    {
+        juce::int64 blocks = 0;
+        juce::int64 eventsIn = 0;
+        juce::int64 eventsOut = 0;
+        juce::int64 totalNs = 0;
+        juce::int64 worstBlockNs = 0;
+        juce::int64 mostEventsInPerBlock = 0;
+        juce::int64 mostEventsOutPerBlock = 0;
+        juce::int64 latchedNotesHighWater = 0;
+        juce::int64 programChangeHits = 0;
+        juce::int64 programChangeMisses = 0;
+        juce::int64 droppedNotifications = 0;
+        juce::int64 droppedRecordedChords = 0;
+        std::array<juce::int64, numHistogramBins> blockTimeHistogram {};
+
+        double getNsPerEvent() const { return eventsIn > 0 ? (double) totalNs / (double) eventsIn : 0.0; }
+        double getAverageBlockNs() const { return blocks > 0 ? (double) totalNs / (double) blocks : 0.0; }
+        // One "name value" pair per line, for monitoring scripts
+        juce::String toText() const;
+    };
+
+    //==============================================================================
+    // Audio thread
+
+    void recordBlock(juce::int64 startTicks, int numEventsIn, int numEventsOut, int numLatchedNotes)
+    {
+        if (resetRequested.exchange(false, std::memory_order_relaxed))
+        {
+            clear();
+        }
+        const auto durationNs = (juce::int64) (juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks) * 1.0e9);
+        add(blocks, 1);
+        add(eventsIn, numEventsIn);
+        add(eventsOut, numEventsOut);
+        add(totalNs, durationNs);
+        raiseTo(worstBlockNs, durationNs);
+        raiseTo(mostEventsInPerBlock, numEventsIn);
+        raiseTo(mostEventsOutPerBlock, numEventsOut);
+        raiseTo(latchedNotesHighWater, numLatchedNotes);
+        add(blockTimeHistogram[(size_t) getHistogramBin(durationNs)], 1);
+    }
+    // Whether a program change found a mapped chord
+    void countProgramChange(bool wasMapped) { add(wasMapped ? programChangeHits : programChangeMisses, 1); }
+    // A state change an open editor will never hear about because its queue was full
+    void countDroppedNotification() { add(droppedNotifications, 1); }
+    // A chord recorded in Record mode that was lost because too many were waiting to be stored
+    void countDroppedRecordedChord() { add(droppedRecordedChords, 1); }
+
+    //==============================================================================
+    // Any thread
+
+    Snapshot getSnapshot() const;
+    // Takes effect at the start of the next block's bookkeeping
+    void reset() { resetRequested.store(true); }
+
+    static int getHistogramBin(juce::int64 durationNs)
+    {
+        int bin = 0;
+        for (juce::int64 limit = firstBinLimitNs; durationNs >= limit && bin < numHistogramBins - 1; limit *= 2)
+        {
+            ++bin;
+        }
+        return bin;
+    }
+
+private:
+    using Counter = std::atomic<juce::int64>;
+
+    static void add(Counter& counter, juce::int64 amount) { counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed); }
+    static void raiseTo(Counter& counter, juce::int64 value)
+    {
+        if (value > counter.load(std::memory_order_relaxed)) { counter.store(value, std::memory_order_relaxed); }
+    }
+    void clear();
+
+    Counter blocks { 0 };
+    Counter eventsIn { 0 };
+    Counter eventsOut { 0 };
+    Counter totalNs { 0 };
+    Counter worstBlockNs { 0 };
+    Counter mostEventsInPerBlock { 0 };
+    Counter mostEventsOutPerBlock { 0 };
+    Counter latchedNotesHighWater { 0 };
+    Counter programChangeHits { 0 };
+    Counter programChangeMisses { 0 };
+    Counter droppedNotifications { 0 };
+    Counter droppedRecordedChords { 0 };
+    std::array<Counter, numHistogramBins> blockTimeHistogram {};
+    std::atomic<bool> resetRequested { false };
+};
@@ -1,96 +1,438 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin editor.
-
-  ==============================================================================
-*/
-
-#include "PluginProcessor.h"
-#include "PluginEditor.h"
-#include <iostream>
-
-//==============================================================================
-MidilatchAudioProcessorEditor::MidilatchAudioProcessorEditor (MidilatchAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p), storeChordsButton("Record"), exportButton("Export"), importButton("Import"), transposeUpButton("Transpose Up"), transposeDownButton("Transpose Down")
-{
-    // Make sure that before the constructor has finished, you've set the
-    // editor's size to whatever you need it to be.
-    setSize (430, 500);
-    
-    storeChordsButton.onClick = [this]{
-        this->audioProcessor.toggleStoring();
-        this->storeChordsButton.setButtonText(this->audioProcessor.getStoring() ? "Recording" : "Record");
-    };
-    
-    storeChordsButton.setSize(130, 30);
-    storeChordsButton.setTopLeftPosition(10, 10);
-    storeChordsButton.setColour(juce::Label::ColourIds::textColourId, juce::Colours::white);
-    addAndMakeVisible(storeChordsButton);
-    
-    exportButton.onClick = [this]{
-        this->exporterTextEditor.setText(this->audioProcessor.getMidiMapping().getStringSerialization());
-    };
-    exportButton.setSize(130, 30);
-    exportButton.setTopLeftPosition(150, 10);
-    addAndMakeVisible(exportButton);
-    
-    importButton.onClick = [this]{
-        this->audioProcessor.getMidiMapping().parseStringSerialization(this->exporterTextEditor.getText().toStdString());
-    };
-    importButton.setSize(130, 30);
-    importButton.setTopLeftPosition(290, 10);
-    addAndMakeVisible(importButton);
-    
-    exporterTextEditor.setTopLeftPosition(10, 50);
-    exporterTextEditor.setSize(410, 30);
-    addAndMakeVisible(exporterTextEditor);
-    
-    transposeDownButton.onClick = [this]{
-        this->audioProcessor.getMidiMapping().transpose(-1);
-    };
-    transposeDownButton.setSize(200, 30);
-    transposeDownButton.setTopLeftPosition(10, 90);
-    addAndMakeVisible(transposeDownButton);
-    
-    transposeUpButton.onClick = [this]{
-        this->audioProcessor.getMidiMapping().transpose(1);
-    };
-    transposeUpButton.setSize(200, 30);
-    transposeUpButton.setTopLeftPosition(220, 90);
-    addAndMakeVisible(transposeUpButton);
-    
-    outputTextEditor.setTopLeftPosition(10, 130);
-    outputTextEditor.setSize(410, 360);
-    outputTextEditor.setReadOnly(true);
-    outputTextEditor.setScrollbarsShown(true);
-    updateOutputText();
-    addAndMakeVisible(outputTextEditor);
-    
-    audioProcessor.setRepaintFn([this](){this->repaint();});
-}
-
-MidilatchAudioProcessorEditor::~MidilatchAudioProcessorEditor()
-{
-}
-
-void MidilatchAudioProcessorEditor::updateOutputText()
-{
-    std::stringstream message;
-    message << "Latched Notes: " << this->audioProcessor.getInfo() << "\n";
-    message << "Mapped Notes: \n";
-    message << this->audioProcessor.getMidiMapping().getDisplayText();
-    outputTextEditor.setText(message.str());
-}
-
-//==============================================================================
-void MidilatchAudioProcessorEditor::paint (juce::Graphics& g)
-{
-    updateOutputText();
-}
-
-void MidilatchAudioProcessorEditor::resized()
-{
-    // This is generally where you'll want to lay out the positions of any
-    // subcomponents in your editor..
-}
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin editor.
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+#include <iostream>
+
+//==============================================================================
+MidilatchAudioProcessorEditor::MidilatchAudioProcessorEditor (MidilatchAudioProcessor& p)
+    : AudioProcessorEditor (&p), audioProcessor (p), storeChordsButton("Record"), exportButton("Export"), importButton("Import"), transposeUpButton("Transpose +"), transposeDownButton("Transpose -"), minimalTransitionsButton("Minimal transitions"), embedSharedMappingButton("Save a copy with the project"), openLibraryButton("Open library"), sendMatchedProgramChangesButton("Send its program change"), undoButton("Undo"), redoButton("Redo"), statsButton("Stats"), telemetryPanel(p.getPerformanceCounters())
+{
+    // Make sure that before the constructor has finished, you've set the
+    // editor's size to whatever you need it to be.
+    setSize (430, 820);
+    
+    storeChordsButton.onClick = [this]{
+        this->audioProcessor.toggleStoring();
+        this->refreshViews();
+    };
+    
+    storeChordsButton.setSize(130, 30);
+    storeChordsButton.setTopLeftPosition(10, 10);
+    storeChordsButton.setColour(juce::Label::ColourIds::textColourId, juce::Colours::white);
+    addAndMakeVisible(storeChordsButton);
+    
+    exportButton.onClick = [this]{
+        this->exporterTextEditor.setText(this->audioProcessor.getMidiMapping().getStringSerialization());
+    };
+    exportButton.setSize(130, 30);
+    exportButton.setTopLeftPosition(150, 10);
+    addAndMakeVisible(exportButton);
+    
+    importButton.onClick = [this]{
+        MidiMapping mapping;
+        const auto result = mapping.parseStringSerialization(this->exporterTextEditor.getText().toStdString());
+        if (result.failed())
+        {
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Import failed", result.getErrorMessage());
+            return;
+        }
+        this->audioProcessor.publishMapping(std::move(mapping), "Import");
+    };
+    importButton.setSize(130, 30);
+    importButton.setTopLeftPosition(290, 10);
+    addAndMakeVisible(importButton);
+    
+    exporterTextEditor.setTopLeftPosition(10, 50);
+    exporterTextEditor.setSize(410, 30);
+    addAndMakeVisible(exporterTextEditor);
+    
+    // Transposing only changes the offset mapped chords are played at
+    transposeDownButton.onClick = [this]{
+        this->audioProcessor.setTransposeOffset(this->audioProcessor.getTransposeOffset() - 1);
+        this->refreshViews();
+    };
+    transposeDownButton.setSize(95, 30);
+    transposeDownButton.setTopLeftPosition(10, 90);
+    addAndMakeVisible(transposeDownButton);
+    
+    transposeLabel.setJustificationType(juce::Justification::centred);
+    transposeLabel.setBounds(105, 90, 90, 30);
+    addAndMakeVisible(transposeLabel);
+    
+    transposeUpButton.onClick = [this]{
+        this->audioProcessor.setTransposeOffset(this->audioProcessor.getTransposeOffset() + 1);
+        this->refreshViews();
+    };
+    transposeUpButton.setSize(95, 30);
+    transposeUpButton.setTopLeftPosition(195, 90);
+    addAndMakeVisible(transposeUpButton);
+    
+    transposeBoundsBox.addItem("Fold notes out of range", 1 + (int) TransposeBounds::fold);
+    transposeBoundsBox.addItem("Clamp notes out of range", 1 + (int) TransposeBounds::clamp);
+    transposeBoundsBox.addItem("Drop notes out of range", 1 + (int) TransposeBounds::drop);
+    transposeBoundsBox.onChange = [this]{
+        this->audioProcessor.setTransposeBounds((TransposeBounds) (this->transposeBoundsBox.getSelectedId() - 1));
+    };
+    transposeBoundsBox.setBounds(300, 90, 120, 30);
+    addAndMakeVisible(transposeBoundsBox);
+    
+    minimalTransitionsButton.onClick = [this]{
+        this->audioProcessor.setMinimalTransitions(this->minimalTransitionsButton.getToggleState());
+    };
+    minimalTransitionsButton.setBounds(10, 130, 200, 30);
+    addAndMakeVisible(minimalTransitionsButton);
+    
+    sharedNotePolicyBox.addItem("Keep shared notes", 1);
+    sharedNotePolicyBox.addItem("Retrigger on new velocity", 2);
+    sharedNotePolicyBox.onChange = [this]{
+        this->audioProcessor.setSharedNotePolicy(this->sharedNotePolicyBox.getSelectedId() == 1 ? SharedNotePolicy::keepSounding : SharedNotePolicy::retriggerIfVelocityChanged);
+    };
+    sharedNotePolicyBox.setBounds(220, 130, 200, 30);
+    addAndMakeVisible(sharedNotePolicyBox);
+    
+    outputPacingBox.addItem("Unpaced output", 1);
+    outputPacingBox.addItem("Pace to DIN midi", 2);
+    outputPacingBox.setSelectedId(audioProcessor.getOutputScheduler().getBytesPerSecond() > 0 ? 2 : 1, juce::dontSendNotification);
+    outputPacingBox.onChange = [this]{
+        this->audioProcessor.getOutputScheduler().setBytesPerSecond(this->outputPacingBox.getSelectedId() == 2 ? OutputScheduler::dinMidiBytesPerSecond : 0);
+    };
+    outputPacingBox.setBounds(10, 170, 200, 30);
+    addAndMakeVisible(outputPacingBox);
+    
+    outputQueueLabel.setBounds(220, 170, 200, 30);
+    addAndMakeVisible(outputQueueLabel);
+    
+    channelLatchBox.addItem("Latch all channels together", 1);
+    channelLatchBox.addItem("Latch each channel separately", 2);
+    channelLatchBox.onChange = [this]{
+        this->audioProcessor.setLatchChannelsSeparately(this->channelLatchBox.getSelectedId() == 2);
+        this->refreshViews();
+    };
+    channelLatchBox.setBounds(10, 210, 200, 30);
+    addAndMakeVisible(channelLatchBox);
+    
+    for (int channel = 1; channel <= 16; ++channel)
+    {
+        mappingChannelBox.addItem("Mapped chords on channel " + juce::String(channel), channel);
+    }
+    mappingChannelBox.onChange = [this]{
+        this->audioProcessor.setMappingChannel(this->mappingChannelBox.getSelectedId());
+    };
+    mappingChannelBox.setBounds(220, 210, 200, 30);
+    addAndMakeVisible(mappingChannelBox);
+    
+    // Typing a name shares the mapping with every instance using that name
+    sharedMappingSetBox.setEditableText(true);
+    sharedMappingSetBox.setTextWhenNothingSelected("Private mapping");
+    sharedMappingSetBox.onChange = [this]{
+        this->audioProcessor.setSharedMappingSet(this->sharedMappingSetBox.getText().trim());
+        this->embedSharedMappingButton.setEnabled(this->audioProcessor.getSharedMappingSet().isNotEmpty());
+        this->refreshSharedMappingSets();
+    };
+    sharedMappingSetBox.setBounds(10, 250, 200, 30);
+    addAndMakeVisible(sharedMappingSetBox);
+    refreshSharedMappingSets();
+    
+    embedSharedMappingButton.setToggleState(audioProcessor.getEmbedSharedMapping(), juce::dontSendNotification);
+    embedSharedMappingButton.setEnabled(audioProcessor.getSharedMappingSet().isNotEmpty());
+    embedSharedMappingButton.onClick = [this]{
+        this->audioProcessor.setEmbedSharedMapping(this->embedSharedMappingButton.getToggleState());
+    };
+    embedSharedMappingButton.setBounds(220, 250, 200, 30);
+    addAndMakeVisible(embedSharedMappingButton);
+    
+    openLibraryButton.onClick = [this]{
+        this->libraryChooser = std::make_unique<juce::FileChooser>("Open a chord library", this->audioProcessor.getChordLibraryFile(), "*.mlib");
+        this->libraryChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles, [this](const juce::FileChooser& chooser)
+        {
+            if (chooser.getResult() == juce::File()) { return; }
+            const auto result = this->audioProcessor.openChordLibrary(chooser.getResult());
+            if (result.failed())
+            {
+                juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Could not open library", result.getErrorMessage());
+            }
+            this->refreshSongs();
+        });
+    };
+    openLibraryButton.setBounds(10, 290, 130, 30);
+    addAndMakeVisible(openLibraryButton);
+    
+    songBox.setTextWhenNothingSelected("No song");
+    songBox.onChange = [this]{
+        const auto result = this->audioProcessor.selectSong(this->songBox.getText());
+        if (result.failed())
+        {
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Could not load song", result.getErrorMessage());
+        }
+    };
+    songBox.setBounds(150, 290, 270, 30);
+    addAndMakeVisible(songBox);
+    refreshSongs();
+    
+    chordMatchingBox.addItem("Don't match played chords", 1 + (int) ChordMatching::off);
+    chordMatchingBox.addItem("Match played chords", 1 + (int) ChordMatching::exact);
+    chordMatchingBox.addItem("Match in any octave", 1 + (int) ChordMatching::anyOctave);
+    chordMatchingBox.setSelectedId(1 + (int) audioProcessor.getChordMatching(), juce::dontSendNotification);
+    chordMatchingBox.onChange = [this]{
+        this->audioProcessor.setChordMatching((ChordMatching) (this->chordMatchingBox.getSelectedId() - 1));
+    };
+    chordMatchingBox.setBounds(10, 330, 200, 30);
+    addAndMakeVisible(chordMatchingBox);
+    
+    sendMatchedProgramChangesButton.setToggleState(audioProcessor.getSendMatchedProgramChanges(), juce::dontSendNotification);
+    sendMatchedProgramChangesButton.onClick = [this]{
+        this->audioProcessor.setSendMatchedProgramChanges(this->sendMatchedProgramChangesButton.getToggleState());
+    };
+    sendMatchedProgramChangesButton.setBounds(220, 330, 200, 30);
+    addAndMakeVisible(sendMatchedProgramChangesButton);
+    
+    // Spread and velocities only apply to mapped chords, see StrumScheduler
+    auto& strummer = audioProcessor.getStrumScheduler();
+    strumDirectionBox.addItem("Strum up", 1 + (int) StrumScheduler::Direction::up);
+    strumDirectionBox.addItem("Strum down", 1 + (int) StrumScheduler::Direction::down);
+    strumDirectionBox.setSelectedId(1 + (int) strummer.getDirection(), juce::dontSendNotification);
+    strumDirectionBox.onChange = [this]{
+        this->audioProcessor.getStrumScheduler().setDirection((StrumScheduler::Direction) (this->strumDirectionBox.getSelectedId() - 1));
+    };
+    strumDirectionBox.setBounds(10, 370, 100, 30);
+    addAndMakeVisible(strumDirectionBox);
+    
+    strumSpreadSlider.setSliderStyle(juce::Slider::IncDecButtons);
+    strumSpreadSlider.setTextBoxStyle(juce::Slider::TextBoxLeft, false, 55, 30);
+    strumSpreadSlider.setRange(0, StrumScheduler::maxSpreadMs, 5);
+    strumSpreadSlider.setTextValueSuffix(" ms");
+    strumSpreadSlider.setValue(strummer.getSpreadMs(), juce::dontSendNotification);
+    strumSpreadSlider.onValueChange = [this]{
+        this->audioProcessor.getStrumScheduler().setSpreadMs((int) this->strumSpreadSlider.getValue());
+    };
+    strumSpreadSlider.setBounds(115, 370, 110, 30);
+    addAndMakeVisible(strumSpreadSlider);
+    
+    // Velocity of the first note, then of the last
+    chordVelocityLabel.setText("Velocity", juce::dontSendNotification);
+    chordVelocityLabel.setBounds(230, 370, 60, 30);
+    addAndMakeVisible(chordVelocityLabel);
+    
+    for (auto* slider : { &firstChordVelocitySlider, &lastChordVelocitySlider })
+    {
+        slider->setSliderStyle(juce::Slider::IncDecButtons);
+        slider->setTextBoxStyle(juce::Slider::TextBoxLeft, false, 30, 30);
+        slider->setRange(1, 127, 1);
+        slider->onValueChange = [this]{
+            this->audioProcessor.getStrumScheduler().setVelocities((int) this->firstChordVelocitySlider.getValue(), (int) this->lastChordVelocitySlider.getValue());
+        };
+        addAndMakeVisible(*slider);
+    }
+    firstChordVelocitySlider.setValue(strummer.getFirstVelocity(), juce::dontSendNotification);
+    firstChordVelocitySlider.setBounds(290, 370, 65, 30);
+    lastChordVelocitySlider.setValue(strummer.getLastVelocity(), juce::dontSendNotification);
+    lastChordVelocitySlider.setBounds(355, 370, 65, 30);
+    
+    // Whether a chord is the keys held together or the notes struck close together
+    chordWindowLabel.setText("Chord capture", juce::dontSendNotification);
+    chordWindowLabel.setBounds(10, 410, 100, 30);
+    addAndMakeVisible(chordWindowLabel);
+    
+    chordWindowSlider.setSliderStyle(juce::Slider::IncDecButtons);
+    chordWindowSlider.setTextBoxStyle(juce::Slider::TextBoxLeft, false, 140, 30);
+    chordWindowSlider.setRange(0, MidilatchAudioProcessor::maxChordWindowMs, 5);
+    chordWindowSlider.textFromValueFunction = [](double value) {
+        const int milliseconds = juce::roundToInt(value);
+        return milliseconds == 0 ? juce::String("Keys held together") : juce::String(milliseconds) + " ms window";
+    };
+    chordWindowSlider.valueFromTextFunction = [](const juce::String& text) { return (double) text.getIntValue(); };
+    chordWindowSlider.onValueChange = [this]{
+        this->audioProcessor.setChordWindowMs((int) this->chordWindowSlider.getValue());
+    };
+    chordWindowSlider.setBounds(115, 410, 220, 30);
+    addAndMakeVisible(chordWindowSlider);
+    
+    latchedLabel.setBounds(10, 450, 410, 20);
+    addAndMakeVisible(latchedLabel);
+    
+    latchedKeyboard.setBounds(10, 470, 410, 50);
+    addAndMakeVisible(latchedKeyboard);
+    
+    mappedLabel.setText("Mapped Notes:", juce::dontSendNotification);
+    mappedLabel.setBounds(10, 525, 170, 20);
+    addAndMakeVisible(mappedLabel);
+    
+    // Steps through recorded chords, imports and songs; the buttons are kept in step
+    // with the history in refreshViews
+    undoButton.onClick = [this]{
+        this->audioProcessor.undoMappingEdit();
+        this->refreshViews();
+    };
+    undoButton.setBounds(180, 525, 75, 20);
+    addAndMakeVisible(undoButton);
+    redoButton.onClick = [this]{
+        this->audioProcessor.redoMappingEdit();
+        this->refreshViews();
+    };
+    redoButton.setBounds(260, 525, 75, 20);
+    addAndMakeVisible(redoButton);
+    
+    mappingList.setSize(395, 0);
+    mappingViewport.setViewedComponent(&mappingList, false);
+    mappingViewport.setScrollBarsShown(true, false);
+    mappingViewport.setBounds(10, 545, 410, 265);
+    addAndMakeVisible(mappingViewport);
+    
+    // The stats panel takes the place of the mapping list while it is shown
+    statsButton.onClick = [this]{
+        const bool showStats = this->statsButton.getToggleState();
+        this->mappingViewport.setVisible(!showStats);
+        this->telemetryPanel.setVisible(showStats);
+        this->mappedLabel.setText(showStats ? "Performance:" : "Mapped Notes:", juce::dontSendNotification);
+        this->framesSinceStatsRefresh = framesPerStatsRefresh;
+    };
+    statsButton.setBounds(340, 525, 80, 20);
+    addAndMakeVisible(statsButton);
+    
+    telemetryPanel.setBounds(10, 545, 410, 265);
+    addChildComponent(telemetryPanel);
+    
+    // The controls above already show the settings of the last state loaded
+    shownStateLoadCount = audioProcessor.getStateLoadCount();
+    refreshViews();
+    
+    // Changes from before the editor was opened are already shown
+    audioProcessor.getStateChanges().drain([](const StateChange&) {});
+    audioProcessor.getStateChanges().getAndClearOverflow();
+    audioProcessor.getStateChanges().setReaderAttached(true);
+    startTimerHz(refreshRateHz);
+}
+
+MidilatchAudioProcessorEditor::~MidilatchAudioProcessorEditor()
+{
+    audioProcessor.getStateChanges().setReaderAttached(false);
+    stopTimer();
+}
+
+void MidilatchAudioProcessorEditor::timerCallback()
+{
+    // Everything that happened since the last frame collapses into a single refresh,
+    // of which the views only repaint what actually differs
+    audioProcessor.getStateChanges().drain([this](const StateChange& change)
+    {
+        if (change.type == StateChange::Type::programChange || change.type == StateChange::Type::chordMatched)
+        {
+            this->mappingList.setActiveMappingKey(change.mappingKey);
+        }
+        else if (change.type == StateChange::Type::matchLost)
+        {
+            this->mappingList.clearActiveMappingKey(change.mappingKey);
+        }
+    });
+    audioProcessor.getStateChanges().getAndClearOverflow();
+    refreshViews();
+    if (telemetryPanel.isVisible() && ++framesSinceStatsRefresh >= framesPerStatsRefresh)
+    {
+        framesSinceStatsRefresh = 0;
+        telemetryPanel.refresh();
+    }
+}
+
+void MidilatchAudioProcessorEditor::refreshSettings()
+{
+    outputPacingBox.setSelectedId(audioProcessor.getOutputScheduler().getBytesPerSecond() > 0 ? 2 : 1, juce::dontSendNotification);
+    refreshSharedMappingSets();
+    embedSharedMappingButton.setToggleState(audioProcessor.getEmbedSharedMapping(), juce::dontSendNotification);
+    embedSharedMappingButton.setEnabled(audioProcessor.getSharedMappingSet().isNotEmpty());
+    refreshSongs();
+    chordMatchingBox.setSelectedId(1 + (int) audioProcessor.getChordMatching(), juce::dontSendNotification);
+    sendMatchedProgramChangesButton.setToggleState(audioProcessor.getSendMatchedProgramChanges(), juce::dontSendNotification);
+    const auto& strummer = audioProcessor.getStrumScheduler();
+    strumDirectionBox.setSelectedId(1 + (int) strummer.getDirection(), juce::dontSendNotification);
+    strumSpreadSlider.setValue(strummer.getSpreadMs(), juce::dontSendNotification);
+    firstChordVelocitySlider.setValue(strummer.getFirstVelocity(), juce::dontSendNotification);
+    lastChordVelocitySlider.setValue(strummer.getLastVelocity(), juce::dontSendNotification);
+}
+
+void MidilatchAudioProcessorEditor::refreshSharedMappingSets()
+{
+    // Offers the sets other instances created, keeping whatever this instance uses
+    const auto current = audioProcessor.getSharedMappingSet();
+    sharedMappingSetBox.clear(juce::dontSendNotification);
+    sharedMappingSetBox.addItemList(audioProcessor.getSharedMappingSetNames(), 1);
+    sharedMappingSetBox.setText(current, juce::dontSendNotification);
+}
+
+void MidilatchAudioProcessorEditor::refreshSongs()
+{
+    songBox.clear(juce::dontSendNotification);
+    songBox.addItemList(audioProcessor.getChordLibrarySongNames(), 1);
+    songBox.setText(audioProcessor.getSelectedSong(), juce::dontSendNotification);
+    songBox.setEnabled(songBox.getNumItems() > 0);
+}
+
+void MidilatchAudioProcessorEditor::refreshViews()
+{
+    // Both are no-ops if nothing changed since the last frame
+    const auto latched = this->audioProcessor.getLatchedPitchMask();
+    if (latched != shownLatchedNotes || !hasShownLatchedNotes)
+    {
+        shownLatchedNotes = latched;
+        hasShownLatchedNotes = true;
+        latchedKeyboard.setLatchedNotes(latched);
+        latchedLabel.setText("Latched Notes: " + latchedKeyboard.getLatchedNoteNames(), juce::dontSendNotification);
+    }
+    // The parameters may be automated, so the controls follow them rather than the
+    // other way round. Setting what is already shown does nothing.
+    storeChordsButton.setButtonText(this->audioProcessor.getStoring() ? "Recording" : "Record");
+    minimalTransitionsButton.setToggleState(this->audioProcessor.getMinimalTransitions(), juce::dontSendNotification);
+    sharedNotePolicyBox.setSelectedId(this->audioProcessor.getSharedNotePolicy() == SharedNotePolicy::keepSounding ? 1 : 2, juce::dontSendNotification);
+    transposeBoundsBox.setSelectedId(1 + (int) this->audioProcessor.getTransposeBounds(), juce::dontSendNotification);
+    const bool separateChannels = this->audioProcessor.getLatchChannelsSeparately();
+    channelLatchBox.setSelectedId(separateChannels ? 2 : 1, juce::dontSendNotification);
+    mappingChannelBox.setSelectedId(this->audioProcessor.getMappingChannel(), juce::dontSendNotification);
+    // Separate latches send their chords on their own channel
+    mappingChannelBox.setEnabled(!separateChannels);
+    chordWindowSlider.setValue(this->audioProcessor.getChordWindowMs(), juce::dontSendNotification);
+    const int transposeOffset = this->audioProcessor.getTransposeOffset();
+    if (transposeOffset != shownTransposeOffset)
+    {
+        shownTransposeOffset = transposeOffset;
+        transposeLabel.setText(transposeOffset > 0 ? "+" + juce::String(transposeOffset) : juce::String(transposeOffset), juce::dontSendNotification);
+    }
+    const auto& scheduler = this->audioProcessor.getOutputScheduler();
+    const int queueDepth = scheduler.getQueueDepth();
+    const int latencyTenthsMs = juce::roundToInt(scheduler.getAddedLatencyMs() * 10.0);
+    if (queueDepth != shownQueueDepth || latencyTenthsMs != shownLatencyTenthsMs)
+    {
+        shownQueueDepth = queueDepth;
+        shownLatencyTenthsMs = latencyTenthsMs;
+        outputQueueLabel.setText("Queued: " + juce::String(queueDepth) + ", +" + juce::String(latencyTenthsMs / 10.0, 1) + " ms", juce::dontSendNotification);
+    }
+    // Loading a state can change settings the host doesn't know as parameters
+    const int stateLoadCount = this->audioProcessor.getStateLoadCount();
+    if (stateLoadCount != shownStateLoadCount)
+    {
+        shownStateLoadCount = stateLoadCount;
+        refreshSettings();
+    }
+    const auto shown = this->audioProcessor.getMidiMappingStore().getVersioned();
+    mappingList.setMapping(shown.mapping, shown.version);
+    undoButton.setEnabled(this->audioProcessor.getMappingUndoDescription().isNotEmpty());
+    redoButton.setEnabled(this->audioProcessor.getMappingRedoDescription().isNotEmpty());
+}
+
+//==============================================================================
+void MidilatchAudioProcessorEditor::paint (juce::Graphics& g)
+{
+    // The views are refreshed from timerCallback, not on every paint
+    g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
+}
+
+void MidilatchAudioProcessorEditor::resized()
+{
+    // This is generally where you'll want to lay out the positions of any
+    // subcomponents in your editor..
+}
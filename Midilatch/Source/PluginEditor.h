@@ -1,42 +1,92 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin editor.
-
-  ==============================================================================
-*/
-
-#pragma once
-
-#include <JuceHeader.h>
-#include "PluginProcessor.h"
-
-//==============================================================================
-/**
-*/
-class MidilatchAudioProcessorEditor  : public juce::AudioProcessorEditor
-{
-public:
-    MidilatchAudioProcessorEditor (MidilatchAudioProcessor&);
-    ~MidilatchAudioProcessorEditor() override;
-
-    //==============================================================================
-    void paint (juce::Graphics&) override;
-    void resized() override;
-
-private:
-    void updateOutputText();
-    
-    // This reference is provided as a quick way for your editor to
-    // access the processor object that created it.
-    MidilatchAudioProcessor& audioProcessor;
-    juce::TextButton storeChordsButton;
-    juce::TextButton exportButton;
-    juce::TextButton importButton;
-    juce::TextButton transposeUpButton;
-    juce::TextButton transposeDownButton;
-    juce::TextEditor exporterTextEditor;
-    juce::TextEditor outputTextEditor;
-
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidilatchAudioProcessorEditor)
-};
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "LatchViews.h"
+#include "TelemetryPanel.h"
+
+//==============================================================================
+/**
+*/
+class MidilatchAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                       private juce::Timer
+{
+public:
+    MidilatchAudioProcessorEditor (MidilatchAudioProcessor&);
+    ~MidilatchAudioProcessorEditor() override;
+
+    //==============================================================================
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+private:
+    void timerCallback() override;
+    void refreshViews();
+    // The controls of settings that aren't parameters, after a state was loaded
+    void refreshSettings();
+    void refreshSharedMappingSets();
+    void refreshSongs();
+    
+    // How often the editor picks up changes from the audio thread
+    static constexpr int refreshRateHz = 30;
+    // The stats panel is text, rebuilt every this many frames while it is shown
+    static constexpr int framesPerStatsRefresh = 15;
+    
+    // This reference is provided as a quick way for your editor to
+    // access the processor object that created it.
+    MidilatchAudioProcessor& audioProcessor;
+    juce::TextButton storeChordsButton;
+    juce::TextButton exportButton;
+    juce::TextButton importButton;
+    juce::TextButton transposeUpButton;
+    juce::TextButton transposeDownButton;
+    juce::Label transposeLabel;
+    juce::ComboBox transposeBoundsBox;
+    juce::TextEditor exporterTextEditor;
+    juce::ToggleButton minimalTransitionsButton;
+    juce::ComboBox sharedNotePolicyBox;
+    juce::ComboBox outputPacingBox;
+    juce::Label outputQueueLabel;
+    juce::ComboBox channelLatchBox;
+    juce::ComboBox mappingChannelBox;
+    juce::ComboBox sharedMappingSetBox;
+    juce::ToggleButton embedSharedMappingButton;
+    juce::TextButton openLibraryButton;
+    juce::ComboBox songBox;
+    std::unique_ptr<juce::FileChooser> libraryChooser;
+    juce::ComboBox chordMatchingBox;
+    juce::ToggleButton sendMatchedProgramChangesButton;
+    juce::ComboBox strumDirectionBox;
+    juce::Slider strumSpreadSlider;
+    juce::Label chordVelocityLabel;
+    juce::Slider firstChordVelocitySlider;
+    juce::Slider lastChordVelocitySlider;
+    juce::Label chordWindowLabel;
+    juce::Slider chordWindowSlider;
+    juce::Label latchedLabel;
+    LatchedKeyboard latchedKeyboard;
+    juce::Label mappedLabel;
+    juce::TextButton undoButton;
+    juce::TextButton redoButton;
+    MappingList mappingList;
+    juce::Viewport mappingViewport;
+    juce::ToggleButton statsButton;
+    TelemetryPanel telemetryPanel;
+    int framesSinceStatsRefresh = 0;
+    std::array<std::uint64_t, 2> shownLatchedNotes {};
+    bool hasShownLatchedNotes = false;
+    int shownQueueDepth = -1;
+    int shownLatencyTenthsMs = -1;
+    int shownTransposeOffset = -1000;
+    int shownStateLoadCount = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidilatchAudioProcessorEditor)
+};
@@ -1,382 +1,809 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin processor.
-
-  ==============================================================================
-*/
-
-#include "PluginProcessor.h"
-#include "PluginEditor.h"
-#include <algorithm>
-
-MidiMapping::MidiMapping() : noteMap()
-{
-}
-
-const std::vector<int> MidiMapping::getNotes(const int programChange) const
-{
-    auto mapping_it = noteMap.find(programChange);
-    if (mapping_it == noteMap.end())
-    {
-        return std::vector<int>();
-    }
-    return mapping_it->second;
-}
-
-const std::string MidiMapping::getDisplayText() const
-{
-    std::stringstream stream;
-    for (auto& it : noteMap)
-    {
-        stream << it.first << ": ";
-        bool has_previous = false;
-        for (int note : it.second)
-        {
-            if (has_previous) { stream << ", "; }
-            has_previous = true;
-            stream << juce::MidiMessage::getMidiNoteName(note, true, true, 4);
-        }
-        stream << "\n";
-    }
-    return stream.str();
-}
-
-const std::string MidiMapping::getStringSerialization() const
-{
-    std::stringstream stream;
-    for (auto& it : noteMap)
-    {
-        stream << it.first << ':';
-        for (int note : it.second)
-        {
-            stream << note << ',';
-        }
-        stream << ';';
-    }
-    return stream.str();
-}
-
-void MidiMapping::parseStringSerialization(std::string text)
-{
-    std::map<int, std::vector<int>> oldMap = noteMap;
-    try {
-        noteMap.clear();
-        std::stringstream buf;
-        int curKey = -1;
-        std::vector<int> curValues;
-        for(const char& c : text)
-        {
-            if(c == ':')
-            {
-                curKey = std::stoi(buf.str());
-                buf.str(std::string());
-            }
-            else if (c == ',')
-            {
-                curValues.push_back(std::stoi(buf.str()));
-                buf.str(std::string());
-            }
-            else if (c == ';')
-            {
-                noteMap[curKey] = curValues;
-                curValues.clear();
-                buf.str(std::string());
-            }
-            else
-            {
-                buf << c;
-            }
-        }
-        if (buf.str().size()) {
-            throw "did not expect any residual string, cancelling serialization";
-        }
-    } catch (...) {
-        noteMap = oldMap;
-    }
-}
-
-void MidiMapping::transpose(int offset)
-{
-    std::map<int, std::vector<int>> newMap;
-    for (auto& it : noteMap)
-    {
-        std::vector<int> newNotes;
-        for (int note : it.second)
-        {
-            int newNote = (note + offset) % 128;
-            if (newNote < 0) {newNote = 128 + newNote;}
-            newNotes.push_back(newNote);
-        }
-        newMap[it.first] = newNotes;
-    }
-    noteMap = newMap;
-}
-
-//==============================================================================
-MidilatchAudioProcessor::MidilatchAudioProcessor()
-#ifndef JucePlugin_PreferredChannelConfigurations
-     : AudioProcessor (BusesProperties()
-                     #if ! JucePlugin_IsMidiEffect
-                      #if ! JucePlugin_IsSynth
-                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
-                      #endif
-                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
-                     #endif
-                       )
-#endif
-{
-    isRecording = false;
-    isStoring = false;
-}
-
-MidilatchAudioProcessor::~MidilatchAudioProcessor()
-{
-}
-
-//==============================================================================
-const juce::String MidilatchAudioProcessor::getName() const
-{
-    return JucePlugin_Name;
-}
-
-bool MidilatchAudioProcessor::acceptsMidi() const
-{
-   #if JucePlugin_WantsMidiInput
-    return true;
-   #else
-    return false;
-   #endif
-}
-
-bool MidilatchAudioProcessor::producesMidi() const
-{
-   #if JucePlugin_ProducesMidiOutput
-    return true;
-   #else
-    return false;
-   #endif
-}
-
-bool MidilatchAudioProcessor::isMidiEffect() const
-{
-   #if JucePlugin_IsMidiEffect
-    return true;
-   #else
-    return false;
-   #endif
-}
-
-double MidilatchAudioProcessor::getTailLengthSeconds() const
-{
-    return 0.0;
-}
-
-int MidilatchAudioProcessor::getNumPrograms()
-{
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
-}
-
-int MidilatchAudioProcessor::getCurrentProgram()
-{
-    return 0;
-}
-
-void MidilatchAudioProcessor::setCurrentProgram (int index)
-{
-}
-
-const juce::String MidilatchAudioProcessor::getProgramName (int index)
-{
-    return {};
-}
-
-void MidilatchAudioProcessor::changeProgramName (int index, const juce::String& newName)
-{
-}
-
-//==============================================================================
-void MidilatchAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
-{
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
-}
-
-void MidilatchAudioProcessor::releaseResources()
-{
-    // When playback stops, you can use this as an opportunity to free up any
-    // spare memory, etc.
-}
-
-#ifndef JucePlugin_PreferredChannelConfigurations
-bool MidilatchAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
-{
-  #if JucePlugin_IsMidiEffect
-    juce::ignoreUnused (layouts);
-    return true;
-  #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
-        return false;
-
-    // This checks if the input layout matches the output layout
-   #if ! JucePlugin_IsSynth
-    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
-        return false;
-   #endif
-
-    return true;
-  #endif
-}
-#endif
-
-std::vector<juce::MidiMessage> MidilatchAudioProcessor::clearActiveNotes()
-{
-    std::vector<juce::MidiMessage> returns;
-    for (const auto oldmessage : this->activeNotes)
-    {
-        returns.push_back(oldmessage.makeNoteOff());
-    }
-    this->activeNotes.clear();
-    return returns;
-}
-
-std::vector<juce::MidiMessage> MidilatchAudioProcessor::activateNote(int note, int channel, float velocity)
-{
-    std::vector<juce::MidiMessage> returns;
-    if (!this->isRecording)
-    {
-        // If we are not recording a chord, send a noteoff for all old active notes and clear the buffer
-        auto cleared = this->clearActiveNotes();
-        returns.insert(returns.begin(), cleared.begin(), cleared.end());
-    }
-    this->isRecording = true;
-    this->activeNotes.emplace(note, channel, velocity);
-    returns.emplace_back(juce::MidiMessage::noteOn(channel, note, velocity));
-    return returns;
-}
-
-void MidilatchAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
-{
-    juce::MidiBuffer processedMidi;
-    for (const auto metadata : midiMessages)
-    {
-        auto message = metadata.getMessage();
-        if (message.isNoteOn())
-        {
-            auto newMidiEvents = this->activateNote(message.getNoteNumber(), message.getChannel(), message.getFloatVelocity());
-            for(const auto& midiEvent: newMidiEvents)
-            {
-                processedMidi.addEvent(midiEvent, metadata.samplePosition);
-            }
-            tryRepaint();
-        }
-        else if (message.isNoteOff())
-        {
-            this->isRecording = false;
-            // Do not add the noteoff (that's the whole point of the plugin)
-        }
-        else if (message.isAllNotesOff())
-        {
-            // On all notes off, clear latched notes - no need to send individual noteoff commands
-            this->activeNotes.clear();
-            processedMidi.addEvent(message, metadata.samplePosition);
-            tryRepaint();
-        }
-        else if (message.isProgramChange())
-        {
-            // When in storing mode, the current notes are assigned to the midi map
-            if (isStoring)
-            {
-                std::vector<int> activeNoteIds;
-                for (const auto& activeNote : activeNotes)
-                {
-                    activeNoteIds.push_back(activeNote.getNote());
-                }
-                midiMapping.assign(message.getProgramChangeNumber(), activeNoteIds);
-            }
-            else
-            {
-                // Clear active notes
-                for(const auto& midiEvent: this->clearActiveNotes())
-                {
-                    processedMidi.addEvent(midiEvent, metadata.samplePosition);
-                }
-                // Record the chord in the mapping and play NoteOn messages
-                this->isRecording = true;
-                for (int newNote : midiMapping.getNotes(message.getProgramChangeNumber()))
-                {
-                    for(const auto& midiEvent: this->activateNote(newNote, 0, 1.0f))
-                    {
-                        processedMidi.addEvent(midiEvent, metadata.samplePosition);
-                    }
-                }
-                this->isRecording = false;
-//                processedMidi.addEvent(message, metadata.samplePosition);
-            }
-            tryRepaint();
-        }
-//        else if(message.isController())
-//        {
-//            // Remap channel 27 to modwheel (1) because I was too stupid to reassign it directly on the board
-//            if (message.getControllerNumber() == 27)
-//                processedMidi.addEvent(juce::MidiMessage::controllerEvent(message.getChannel(), 1, message.getControllerValue()), metadata.samplePosition);
-//            else
-//                processedMidi.addEvent(message, metadata.samplePosition);
-//        }
-        else
-        {
-            processedMidi.addEvent(message, metadata.samplePosition);
-        }
-    }
-    midiMessages.swapWith (processedMidi);
-}
-
-std::string MidilatchAudioProcessor::getInfo() const
-{
-    std::stringstream buf;
-    bool has_previous = false;
-    for (const auto note : this->activeNotes)
-    {
-        if (has_previous) {buf << ", ";}
-        has_previous = true;
-        buf << juce::MidiMessage::getMidiNoteName(note.getNote(), true, true, 4);
-    }
-    return buf.str();
-}
-
-//==============================================================================
-bool MidilatchAudioProcessor::hasEditor() const
-{
-    return true; // (change this to false if you choose to not supply an editor)
-}
-
-juce::AudioProcessorEditor* MidilatchAudioProcessor::createEditor()
-{
-    return new MidilatchAudioProcessorEditor (*this);
-}
-
-//==============================================================================
-void MidilatchAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
-{
-    std::string textMidiMapping = midiMapping.getStringSerialization();
-    destData.append(textMidiMapping.c_str(), textMidiMapping.size());
-}
-
-void MidilatchAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
-{
-    std::string textMidiMapping((const char*)data, sizeInBytes);
-    midiMapping.parseStringSerialization(textMidiMapping);
-}
-
-//==============================================================================
-// This creates new instances of the plugin..
-juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
-{
-    return new MidilatchAudioProcessor();
-}
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin processor.
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+#include "NoteNames.h"
+#include "StateFormat.h"
+#include <algorithm>
+
+//==============================================================================
+MidilatchAudioProcessor::MidilatchAudioProcessor()
+#ifndef JucePlugin_PreferredChannelConfigurations
+     : AudioProcessor (BusesProperties()
+                     #if ! JucePlugin_IsMidiEffect
+                      #if ! JucePlugin_IsSynth
+                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                      #endif
+                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
+                     #endif
+                       ),
+#else
+     :
+#endif
+       parameters (*this, nullptr, "Parameters", createParameterLayout())
+{
+    recordParameter = parameters.getRawParameterValue(ParameterIds::record);
+    minimalTransitionsParameter = parameters.getRawParameterValue(ParameterIds::minimalTransitions);
+    sharedNotePolicyParameter = parameters.getRawParameterValue(ParameterIds::sharedNotePolicy);
+    latchChannelsSeparatelyParameter = parameters.getRawParameterValue(ParameterIds::latchChannelsSeparately);
+    mappingChannelParameter = parameters.getRawParameterValue(ParameterIds::mappingChannel);
+    transposeOffsetParameter = parameters.getRawParameterValue(ParameterIds::transposeOffset);
+    transposeBoundsParameter = parameters.getRawParameterValue(ParameterIds::transposeBounds);
+    chordWindowMsParameter = parameters.getRawParameterValue(ParameterIds::chordWindowMs);
+    matchedMappingKeys.fill(ChordIndex::notFound);
+    // Applies recorded chords and frees mapping snapshots the audio thread is done with
+    startTimerHz(10);
+}
+
+MidilatchAudioProcessor::~MidilatchAudioProcessor()
+{
+    stopTimer();
+    setSharedMappingSet({});
+}
+
+void MidilatchAudioProcessor::timerCallback()
+{
+    if (mappingStore.collectGarbage())
+    {
+        recordMappingEdit("Record");
+        // Chords recorded here reach the other instances sharing the set
+        shareMapping();
+    }
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout MidilatchAudioProcessor::createParameterLayout()
+{
+    // Choices are in the order of their enums, so a choice's index is its enum value
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { ParameterIds::record, 1 }, "Record", false));
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { ParameterIds::minimalTransitions, 1 }, "Minimal transitions", false));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { ParameterIds::sharedNotePolicy, 1 }, "Shared notes",
+                                                            juce::StringArray { "Keep", "Retrigger on new velocity" }, 0));
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID { ParameterIds::latchChannelsSeparately, 1 }, "Latch channels separately", false));
+    layout.add(std::make_unique<juce::AudioParameterInt>(juce::ParameterID { ParameterIds::mappingChannel, 1 }, "Mapping channel", 1, 16, 1));
+    layout.add(std::make_unique<juce::AudioParameterInt>(juce::ParameterID { ParameterIds::transposeOffset, 1 }, "Transpose",
+                                                         -maxTransposeOffset, maxTransposeOffset, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { ParameterIds::transposeBounds, 1 }, "Transpose bounds",
+                                                            juce::StringArray { "Fold", "Clamp", "Drop" }, 0));
+    layout.add(std::make_unique<juce::AudioParameterInt>(juce::ParameterID { ParameterIds::chordWindowMs, 1 }, "Chord window", 0, maxChordWindowMs, 0));
+    return layout;
+}
+
+void MidilatchAudioProcessor::setParameter(const char* parameterId, float value)
+{
+    auto* parameter = parameters.getParameter(parameterId);
+    parameter->beginChangeGesture();
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    parameter->endChangeGesture();
+}
+
+void MidilatchAudioProcessor::restoreParameter(const char* parameterId, float value)
+{
+    auto* parameter = parameters.getParameter(parameterId);
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+//==============================================================================
+void MidilatchAudioProcessor::publishMapping(MidiMapping mapping, const juce::String& description)
+{
+    // Keeps the history step down to the pages that actually changed
+    mappingStore.publishSharingUnchanged(std::move(mapping));
+    recordMappingEdit(description);
+    shareMapping();
+}
+
+void MidilatchAudioProcessor::recordMappingEdit(const juce::String& description)
+{
+    const auto& mapping = mappingStore.get();
+    const RealtimeWatchdog::ScopedLock lock(mappingHistoryLock);
+    if (!mapping.sharesAllPagesWith(mappingHistory.getCurrent()))
+    {
+        mappingHistory.push(mapping, description);
+    }
+}
+
+bool MidilatchAudioProcessor::undoMappingEdit()
+{
+    MidiMapping mapping;
+    {
+        const RealtimeWatchdog::ScopedLock lock(mappingHistoryLock);
+        if (!mappingHistory.undo()) { return false; }
+        mapping = mappingHistory.getCurrent();
+    }
+    mappingStore.publish(std::move(mapping));
+    shareMapping();
+    return true;
+}
+
+bool MidilatchAudioProcessor::redoMappingEdit()
+{
+    MidiMapping mapping;
+    {
+        const RealtimeWatchdog::ScopedLock lock(mappingHistoryLock);
+        if (!mappingHistory.redo()) { return false; }
+        mapping = mappingHistory.getCurrent();
+    }
+    mappingStore.publish(std::move(mapping));
+    shareMapping();
+    return true;
+}
+
+juce::String MidilatchAudioProcessor::getMappingUndoDescription() const
+{
+    const RealtimeWatchdog::ScopedLock lock(mappingHistoryLock);
+    return mappingHistory.getUndoDescription();
+}
+
+juce::String MidilatchAudioProcessor::getMappingRedoDescription() const
+{
+    const RealtimeWatchdog::ScopedLock lock(mappingHistoryLock);
+    return mappingHistory.getRedoDescription();
+}
+
+void MidilatchAudioProcessor::shareMapping()
+{
+    const RealtimeWatchdog::ScopedLock lock(sharedMappingSetLock);
+    if (sharedMappingSet.isNotEmpty())
+    {
+        mappingLibrary->publish(sharedMappingSet, mappingStore.getIndexed(), this);
+    }
+}
+
+void MidilatchAudioProcessor::mappingSetChanged(const IndexedMapping& mapping)
+{
+    // Shares the pages and the index of the other instance's mapping, nothing is parsed,
+    // copied deeply or indexed again
+    mappingStore.publish(mapping.mapping, mapping.chordIndex);
+    recordMappingEdit("Shared set");
+}
+
+void MidilatchAudioProcessor::setSharedMappingSet(const juce::String& name)
+{
+    const RealtimeWatchdog::ScopedLock lock(sharedMappingSetLock);
+    if (name == sharedMappingSet) { return; }
+    if (sharedMappingSet.isNotEmpty())
+    {
+        // The mapping stays as it is, from now on as a private copy
+        mappingLibrary->unsubscribe(sharedMappingSet, *this);
+    }
+    sharedMappingSet = name;
+    if (name.isNotEmpty())
+    {
+        // A new set starts out with this instance's mapping
+        auto shared = mappingLibrary->subscribe(name, *this, mappingStore.getIndexed());
+        mappingStore.publish(std::move(shared.mapping), std::move(shared.chordIndex));
+        recordMappingEdit("Shared set");
+    }
+}
+
+juce::String MidilatchAudioProcessor::getSharedMappingSet() const
+{
+    const RealtimeWatchdog::ScopedLock lock(sharedMappingSetLock);
+    return sharedMappingSet;
+}
+
+juce::Result MidilatchAudioProcessor::openChordLibrary(const juce::File& file)
+{
+    const RealtimeWatchdog::ScopedLock lock(chordLibraryLock);
+    const auto result = chordLibrary.open(file);
+    // A file that can't be opened leaves the current library and song in place
+    if (result.wasOk())
+    {
+        selectedSong = {};
+    }
+    return result;
+}
+
+juce::File MidilatchAudioProcessor::getChordLibraryFile() const
+{
+    const RealtimeWatchdog::ScopedLock lock(chordLibraryLock);
+    return chordLibrary.getFile();
+}
+
+juce::StringArray MidilatchAudioProcessor::getChordLibrarySongNames() const
+{
+    const RealtimeWatchdog::ScopedLock lock(chordLibraryLock);
+    juce::StringArray names;
+    names.ensureStorageAllocated(chordLibrary.getNumSongs());
+    for (int i = 0; i < chordLibrary.getNumSongs(); ++i)
+    {
+        names.add(chordLibrary.getSongName(i));
+    }
+    return names;
+}
+
+juce::Result MidilatchAudioProcessor::selectSong(const juce::String& name)
+{
+    MidiMapping mapping;
+    {
+        const RealtimeWatchdog::ScopedLock lock(chordLibraryLock);
+        const auto result = chordLibrary.loadSong(chordLibrary.indexOfSong(name), mapping);
+        if (result.failed()) { return result; }
+        selectedSong = name;
+    }
+    publishMapping(std::move(mapping), "Song");
+    return juce::Result::ok();
+}
+
+juce::String MidilatchAudioProcessor::getSelectedSong() const
+{
+    const RealtimeWatchdog::ScopedLock lock(chordLibraryLock);
+    return selectedSong;
+}
+
+//==============================================================================
+const juce::String MidilatchAudioProcessor::getName() const
+{
+    return JucePlugin_Name;
+}
+
+bool MidilatchAudioProcessor::acceptsMidi() const
+{
+   #if JucePlugin_WantsMidiInput
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+bool MidilatchAudioProcessor::producesMidi() const
+{
+   #if JucePlugin_ProducesMidiOutput
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+bool MidilatchAudioProcessor::isMidiEffect() const
+{
+   #if JucePlugin_IsMidiEffect
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+double MidilatchAudioProcessor::getTailLengthSeconds() const
+{
+    return 0.0;
+}
+
+int MidilatchAudioProcessor::getNumPrograms()
+{
+    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
+                // so this should be at least 1, even if you're not really implementing programs.
+}
+
+int MidilatchAudioProcessor::getCurrentProgram()
+{
+    return 0;
+}
+
+void MidilatchAudioProcessor::setCurrentProgram (int index)
+{
+}
+
+const juce::String MidilatchAudioProcessor::getProgramName (int index)
+{
+    return {};
+}
+
+void MidilatchAudioProcessor::changeProgramName (int index, const juce::String& newName)
+{
+}
+
+//==============================================================================
+void MidilatchAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
+{
+    // Reserve enough room for the worst case of one block: releasing every latched
+    // note, every waiting strummed or paced note and a handful of events per sample,
+    // plus the longest message the output scheduler holds, so processedMidi never
+    // reallocates in processBlock. A short midi event takes a sample position, a size
+    // field and three data bytes.
+    const int bytesPerEvent = sizeof(juce::int32) + sizeof(juce::uint16) + 3;
+    reservedMidiBytes = (size_t) (2 * LatchedNotes::capacity + StrumScheduler::capacity + OutputScheduler::capacity + 4 * samplesPerBlock) * bytesPerEvent
+                      + (size_t) OutputScheduler::longMessageCapacity;
+    processedMidi.ensureSize(reservedMidiBytes);
+    outputScheduler.prepare(sampleRate);
+    strumScheduler.prepare(sampleRate);
+    processedSamples = 0;
+    currentSampleRate = sampleRate;
+    // Snapshots freed while stopped may come back at the same address
+    mappingInUse = nullptr;
+    mappingStore.setAudioThreadIdle(false);
+}
+
+void MidilatchAudioProcessor::releaseResources()
+{
+    // When playback stops, you can use this as an opportunity to free up any
+    // spare memory, etc.
+    mappingStore.setAudioThreadIdle(true);
+}
+
+#ifndef JucePlugin_PreferredChannelConfigurations
+bool MidilatchAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
+{
+  #if JucePlugin_IsMidiEffect
+    juce::ignoreUnused (layouts);
+    return true;
+  #else
+    // This is the place where you check if the layout is supported.
+    // In this template code we only support mono or stereo.
+    // Some plugin hosts, such as certain GarageBand versions, will only
+    // load plugins that support stereo bus layouts.
+    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
+     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+        return false;
+
+    // This checks if the input layout matches the output layout
+   #if ! JucePlugin_IsSynth
+    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
+        return false;
+   #endif
+
+    return true;
+  #endif
+}
+#endif
+
+struct MidilatchAudioProcessor::EngineHost
+{
+    using Chord = MappingEntry;
+
+    MidilatchAudioProcessor& processor;
+    const MidiMapping& mapping;
+    // Whether mapped chords go through the strum scheduler this block
+    const bool strumming;
+
+    void write(const std::uint8_t* bytes, int numBytes, int samplePosition)
+    {
+        auto& strummer = processor.strumScheduler;
+        if (strummer.hasPendingNotes() && numBytes == 3)
+        {
+            // Releasing a note that is still waiting to be strummed cancels both, an all
+            // notes off cancels whatever waits for the latch it clears
+            const int channelIndex = bytes[0] & 0x0f;
+            if ((bytes[0] & 0xf0) == 0x80 && !strummer.release(channelIndex, bytes[1], processor.processedSamples + samplePosition))
+            {
+                return;
+            }
+            if ((bytes[0] & 0xf0) == 0xb0 && bytes[1] == 123)
+            {
+                const auto& latchOfChannel = processor.latchState.latchOfChannel;
+                strummer.cancelChannels([&](int pendingChannelIndex)
+                {
+                    return latchOfChannel[(size_t) pendingChannelIndex] == latchOfChannel[(size_t) channelIndex];
+                });
+            }
+        }
+        processor.processedMidi.addEvent(bytes, numBytes, samplePosition);
+    }
+    std::uint8_t chordVelocity(const std::array<std::uint64_t, 2>& pitchMask, int note) const
+    {
+        return strumming ? processor.strumScheduler.getChordVelocity(pitchMask, note) : 127;
+    }
+    void writeChordNoteOns(const MappingEntry& entry, int channelIndex, int samplePosition)
+    {
+        if (strumming)
+        {
+            for (int note : entry.notes) { writeChordNote(note, channelIndex, samplePosition); }
+            chordWritten(entry.pitchMask, channelIndex, samplePosition);
+            return;
+        }
+        writeChord(entry.noteOns, entry, 0x90, channelIndex, samplePosition);
+    }
+    void writeChordNote(int note, int channelIndex, int samplePosition)
+    {
+        if (strumming)
+        {
+            processor.strumScheduler.addChordNote(channelIndex, note);
+            return;
+        }
+        const juce::uint8 bytes[] = { (juce::uint8) (0x90 | channelIndex), (juce::uint8) note, 127 };
+        processor.processedMidi.addEvent(bytes, 3, samplePosition);
+    }
+    void chordWritten(const std::array<std::uint64_t, 2>& pitchMask, int channelIndex, int samplePosition)
+    {
+        if (strumming)
+        {
+            processor.strumScheduler.startChord(pitchMask, processor.processedMidi, processor.processedSamples, samplePosition);
+        }
+    }
+    void writeChordNoteOffs(const MappingEntry& entry, int channelIndex, int samplePosition)
+    {
+        if (processor.strumScheduler.hasPendingNotes())
+        {
+            // Some of the notes may not have started yet, so each goes through write()
+            for (int note = 0; note < LatchedNotes::numNotes; ++note)
+            {
+                if ((entry.pitchMask[(size_t) (note >> 6)] >> (note & 63)) & 1)
+                {
+                    const juce::uint8 bytes[] = { (juce::uint8) (0x80 | channelIndex), (juce::uint8) note, 0 };
+                    write(bytes, 3, samplePosition);
+                }
+            }
+            return;
+        }
+        writeChord(entry.noteOffs, entry, 0x80, channelIndex, samplePosition);
+    }
+    // The entry's prebuilt events are on the default mapping channel, any other
+    // channel gets the same events one by one
+    void writeChord(const juce::MidiBuffer& prebuilt, const MappingEntry& entry, int status, int channelIndex, int samplePosition)
+    {
+        if (channelIndex == LatchedNotes::mappingChannelIndex)
+        {
+            processor.processedMidi.addEvents(prebuilt, 0, -1, samplePosition);
+            return;
+        }
+        if (status == 0x90)
+        {
+            for (int note : entry.notes)
+            {
+                const juce::uint8 bytes[] = { (juce::uint8) (0x90 | channelIndex), (juce::uint8) note, 127 };
+                processor.processedMidi.addEvent(bytes, 3, samplePosition);
+            }
+            return;
+        }
+        // Like the prebuilt note offs, one per note, so a note stored twice is released once
+        for (int note = 0; note < LatchedNotes::numNotes; ++note)
+        {
+            if ((entry.pitchMask[(size_t) (note >> 6)] >> (note & 63)) & 1)
+            {
+                const juce::uint8 bytes[] = { (juce::uint8) (0x80 | channelIndex), (juce::uint8) note, 0 };
+                processor.processedMidi.addEvent(bytes, 3, samplePosition);
+            }
+        }
+    }
+    const MappingEntry* findChord(int mappingKey)
+    {
+        MIDILATCH_REALTIME_TAG("processBlock: program change");
+        const auto* entry = mapping.find(mappingKey);
+        processor.performanceCounters.countProgramChange(entry != nullptr);
+        return entry;
+    }
+    void storeChord(int mappingKey, const std::array<std::uint64_t, 2>& pitchMask)
+    {
+        // The mapping is immutable here, so the chord is queued for the message thread
+        MIDILATCH_REALTIME_TAG("processBlock: store chord");
+        auto& chord = processor.chordToStore;
+        chord.mappingKey = mappingKey;
+        chord.numNotes = 0;
+        for (int note = 0; note < LatchedNotes::numNotes; ++note)
+        {
+            if ((pitchMask[(size_t) (note >> 6)] >> (note & 63)) & 1)
+            {
+                chord.notes[(size_t) chord.numNotes++] = (juce::uint8) note;
+            }
+        }
+        if (!processor.mappingStore.pushStoredChord(chord))
+        {
+            // The message thread has not caught up with the chords recorded before
+            processor.performanceCounters.countDroppedRecordedChord();
+            return;
+        }
+        processor.notifyEditor({ StateChange::Type::chordStored, mappingKey, pitchMask });
+    }
+    void programChanged(int mappingKey, const LatchedNotes& notes)
+    {
+        processor.notifyEditor({ StateChange::Type::programChange, mappingKey, notes.getPitchMask() });
+    }
+};
+
+void MidilatchAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    MIDILATCH_REALTIME_SCOPE("processBlock");
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    const int midiMessagesIn = midiMessages.getNumEvents();
+    processedMidi.clear();
+    const MidiMapping& midiMapping = acquireMapping();
+    // Parameters are read once, at the start of the block: the host hands over their
+    // changes between blocks, and a block is never processed with half of a change
+    const bool recording = getStoring();
+    latchState.sharedNotePolicy = getSharedNotePolicy();
+    latchState.transposition = { getTransposeOffset(), getTransposeBounds() };
+    latchState.captureWindow = (juce::int64) (getChordWindowMs() * currentSampleRate / 1000.0);
+    latchState.blockStartTime = processedSamples;
+    // Either every channel plays into a latch of its own whose chords are mapped onto
+    // that same channel, or all channels share latch 0
+    const bool separateChannels = getLatchChannelsSeparately();
+    const int mappingChannelIndex = LatchedNotes::toChannelIndex(getMappingChannel());
+    for (int channelIndex = 0; channelIndex < LatchedNotes::numChannels; ++channelIndex)
+    {
+        latchState.latchOfChannel[(size_t) channelIndex] = (std::uint8_t) (separateChannels ? channelIndex : 0);
+        latchState.setMappingChannel(channelIndex, separateChannels ? channelIndex : mappingChannelIndex);
+    }
+    if (separateChannels != latchesSeparate)
+    {
+        latchesSeparate = separateChannels;
+        latchState.regroupLatches();
+    }
+    EngineHost host { *this, midiMapping, strumScheduler.isActive() };
+    // Picks the engine specialisation once per block instead of branching on the
+    // settings for every message. The editor hears about the latched set at most
+    // once per block.
+    bool latchedNotesChanged = false;
+    {
+        MIDILATCH_REALTIME_TAG("processBlock: latch engine");
+        const bool minimal = getMinimalTransitions();
+        if (recording)
+        {
+            latchedNotesChanged = minimal ? LatchEngine<RecordChordsMode, MinimalTransitions>::process(latchState, midiMessages, host)
+                                          : LatchEngine<RecordChordsMode, FullTransitions>::process(latchState, midiMessages, host);
+        }
+        else
+        {
+            latchedNotesChanged = minimal ? LatchEngine<PedalMappedMode, MinimalTransitions>::process(latchState, midiMessages, host)
+                                          : LatchEngine<PedalMappedMode, FullTransitions>::process(latchState, midiMessages, host);
+        }
+    }
+    // Strummed notes that fall into this block, whether their chord started in it or earlier
+    strumScheduler.process(processedMidi, processedSamples, buffer.getNumSamples());
+    if (latchedNotesChanged)
+    {
+        matchLatchedChord(mappingStore.getAcquiredChordIndex(), recording);
+    }
+    // Copy back instead of swapping, so processedMidi keeps its reserved storage
+    midiMessages.clear();
+    MIDILATCH_REALTIME_TAG("processBlock: output");
+    // The host sized its buffer for the input, and one program change can fire a chord
+    // of many notes. Growing it to the worst case here, rather than by whichever event
+    // doesn't fit, does nothing once it has the room, so a host that reuses its buffer
+    // from block to block (as JUCE's wrappers do) sees one allocation on the first
+    // block. That one can't be avoided: the buffer is the host's, not the plugin's.
+    midiMessages.ensureSize(reservedMidiBytes);
+    if (outputScheduler.isActive())
+    {
+        outputScheduler.process(processedMidi, midiMessages, processedSamples, buffer.getNumSamples());
+    }
+    else
+    {
+        midiMessages.addEvents(processedMidi, 0, -1, 0);
+    }
+    processedSamples += buffer.getNumSamples();
+
+    if (latchedNotesChanged)
+    {
+        publishLatchedNotes();
+    }
+    performanceCounters.recordBlock(startTicks, midiMessagesIn, midiMessages.getNumEvents(), latchState.notes.size());
+}
+
+void MidilatchAudioProcessor::processBlockBypassed (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    juce::AudioProcessor::processBlockBypassed(buffer, midiMessages);
+    // Hosts keep calling this instead of processBlock while the plugin is bypassed, so
+    // mappings published meanwhile are still acknowledged and can be freed
+    acquireMapping();
+}
+
+const MidiMapping& MidilatchAudioProcessor::acquireMapping()
+{
+    const MidiMapping& midiMapping = mappingStore.acquire();
+    if (&midiMapping != mappingInUse)
+    {
+        // Entries of the previous snapshot may be freed from now on
+        mappingInUse = &midiMapping;
+        latchState.forgetLatchedChords();
+    }
+    return midiMapping;
+}
+
+void MidilatchAudioProcessor::notifyEditor(const StateChange& change)
+{
+    // Without an editor there is nobody to tell, and nothing is lost
+    if (!stateChanges.isReaderAttached()) { return; }
+    if (!stateChanges.push(change))
+    {
+        performanceCounters.countDroppedNotification();
+    }
+}
+
+void MidilatchAudioProcessor::publishLatchedNotes()
+{
+    const auto mask = latchState.notes.getPitchMask();
+    latchedPitchMask[0].store(mask[0], std::memory_order_relaxed);
+    latchedPitchMask[1].store(mask[1], std::memory_order_relaxed);
+    notifyEditor({ StateChange::Type::latchedNotes, 0, mask });
+}
+
+void MidilatchAudioProcessor::matchLatchedChord(const ChordIndex& chordIndex, bool recording)
+{
+    // Looked up once per block the latched set changed in, so a chord played key by key
+    // is matched as it stands at the end of the block. Every latch is matched on its
+    // own. Chords are not matched while recording, where they are about to be mapped
+    // anyway.
+    MIDILATCH_REALTIME_TAG("processBlock: chord matching");
+    const auto matching = chordMatching.load(std::memory_order_relaxed);
+    for (size_t latchIndex = 0; latchIndex < latchState.latches.size(); ++latchIndex)
+    {
+        const auto& latch = latchState.latches[latchIndex];
+        auto& matchedMappingKey = matchedMappingKeys[latchIndex];
+        if (latch.channels == 0 && matchedMappingKey == ChordIndex::notFound) { continue; }
+
+        int mappingKey = ChordIndex::notFound;
+        const auto mask = latchState.notes.getPitchMask(latch.channels);
+        if (matching == ChordMatching::exact && !recording)
+        {
+            mappingKey = chordIndex.findExact(mask);
+        }
+        else if (matching == ChordMatching::anyOctave && !recording)
+        {
+            mappingKey = chordIndex.findPitchClasses(ChordNames::toPitchClassMask(mask));
+        }
+        if (mappingKey == matchedMappingKey) { continue; }
+        if (matchedMappingKey != ChordIndex::notFound)
+        {
+            notifyEditor({ StateChange::Type::matchLost, matchedMappingKey, mask });
+        }
+        matchedMappingKey = mappingKey;
+        if (mappingKey == ChordIndex::notFound) { continue; }
+
+        notifyEditor({ StateChange::Type::chordMatched, mappingKey, mask });
+        if (sendMatchedProgramChanges.load(std::memory_order_relaxed) && mappingKey != latch.firedMappingKey)
+        {
+            // After the notes of the chord, bank select first so the receiver never
+            // applies the program to a bank selected earlier
+            const auto channelIndex = (juce::uint8) latch.mappingChannelIndex;
+            const int samplePosition = processedMidi.getNumEvents() > 0 ? processedMidi.getLastEventTime() : 0;
+            const int bank = MidiMapping::getBank(mappingKey);
+            const juce::uint8 bankMsb[] = { (juce::uint8) (0xb0 | channelIndex), 0, (juce::uint8) (bank >> 7) };
+            const juce::uint8 bankLsb[] = { (juce::uint8) (0xb0 | channelIndex), 32, (juce::uint8) (bank & 127) };
+            const juce::uint8 programChange[] = { (juce::uint8) (0xc0 | channelIndex), (juce::uint8) MidiMapping::getProgram(mappingKey) };
+            processedMidi.addEvent(bankMsb, 3, samplePosition);
+            processedMidi.addEvent(bankLsb, 3, samplePosition);
+            processedMidi.addEvent(programChange, 2, samplePosition);
+        }
+    }
+}
+
+std::string MidilatchAudioProcessor::getInfo() const
+{
+    std::stringstream buf;
+    bool has_previous = false;
+    const auto mask = getLatchedPitchMask();
+    const auto chordName = ChordNames::getName(mask);
+    if (!chordName.empty())
+    {
+        buf << chordName << " - ";
+    }
+    for (int note = 0; note < LatchedNotes::numNotes; ++note)
+    {
+        if (!((mask[(size_t) (note >> 6)] >> (note & 63)) & 1)) { continue; }
+        if (has_previous) {buf << ", ";}
+        has_previous = true;
+        buf << getNoteName(note);
+    }
+    return buf.str();
+}
+
+//==============================================================================
+bool MidilatchAudioProcessor::hasEditor() const
+{
+    return true; // (change this to false if you choose to not supply an editor)
+}
+
+juce::AudioProcessorEditor* MidilatchAudioProcessor::createEditor()
+{
+    return new MidilatchAudioProcessorEditor (*this);
+}
+
+//==============================================================================
+void MidilatchAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    StateFormat::Settings settings;
+    settings.minimalTransitions = getMinimalTransitions();
+    settings.sharedNotePolicy = (int) getSharedNotePolicy();
+    settings.outputBytesPerSecond = outputScheduler.getBytesPerSecond();
+    settings.latchChannelsSeparately = getLatchChannelsSeparately();
+    settings.mappingChannel = getMappingChannel();
+    settings.transposeOffset = getTransposeOffset();
+    settings.transposeBounds = (int) getTransposeBounds();
+    settings.chordWindowMs = getChordWindowMs();
+    settings.chordMatching = (int) getChordMatching();
+    settings.strumDirection = (int) strumScheduler.getDirection();
+    settings.strumSpreadMs = strumScheduler.getSpreadMs();
+    settings.firstChordVelocity = strumScheduler.getFirstVelocity();
+    settings.lastChordVelocity = strumScheduler.getLastVelocity();
+    settings.sendMatchedProgramChanges = getSendMatchedProgramChanges();
+    settings.sharedMappingSet = getSharedMappingSet();
+    settings.embedsMapping = settings.sharedMappingSet.isEmpty() || getEmbedSharedMapping();
+    settings.chordLibrary = getChordLibraryFile().getFullPathName();
+    settings.selectedSong = getSelectedSong();
+    StateFormat::write(settings.embedsMapping ? mappingStore.get() : MidiMapping(), settings, destData);
+}
+
+void MidilatchAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    MidiMapping mapping;
+    juce::String mappingSet;
+    juce::String libraryPath, song;
+    juce::Result result = juce::Result::ok();
+    if (StateFormat::isBinary(data, (size_t) sizeInBytes))
+    {
+        StateFormat::Settings settings;
+        result = StateFormat::read(data, (size_t) sizeInBytes, mapping, settings);
+        if (result.wasOk())
+        {
+            // The parameters' ranges clamp out of range values
+            restoreParameter(ParameterIds::minimalTransitions, settings.minimalTransitions ? 1.0f : 0.0f);
+            restoreParameter(ParameterIds::sharedNotePolicy, (float) (settings.sharedNotePolicy == (int) SharedNotePolicy::retriggerIfVelocityChanged
+                                                                          ? SharedNotePolicy::retriggerIfVelocityChanged : SharedNotePolicy::keepSounding));
+            outputScheduler.setBytesPerSecond(juce::jmax(0, settings.outputBytesPerSecond));
+            restoreParameter(ParameterIds::latchChannelsSeparately, settings.latchChannelsSeparately ? 1.0f : 0.0f);
+            restoreParameter(ParameterIds::mappingChannel, (float) settings.mappingChannel);
+            restoreParameter(ParameterIds::transposeOffset, (float) settings.transposeOffset);
+            restoreParameter(ParameterIds::transposeBounds, (float) (settings.transposeBounds == (int) TransposeBounds::clamp ? TransposeBounds::clamp
+                                                                     : settings.transposeBounds == (int) TransposeBounds::drop ? TransposeBounds::drop
+                                                                     : TransposeBounds::fold));
+            restoreParameter(ParameterIds::chordWindowMs, (float) settings.chordWindowMs);
+            setEmbedSharedMapping(settings.embedsMapping);
+            setChordMatching(settings.chordMatching == (int) ChordMatching::exact ? ChordMatching::exact
+                             : settings.chordMatching == (int) ChordMatching::anyOctave ? ChordMatching::anyOctave : ChordMatching::off);
+            setSendMatchedProgramChanges(settings.sendMatchedProgramChanges);
+            strumScheduler.setDirection(settings.strumDirection == (int) StrumScheduler::Direction::down ? StrumScheduler::Direction::down
+                                                                                                       : StrumScheduler::Direction::up);
+            strumScheduler.setSpreadMs(settings.strumSpreadMs);
+            strumScheduler.setVelocities(settings.firstChordVelocity, settings.lastChordVelocity);
+            mappingSet = settings.sharedMappingSet;
+            libraryPath = settings.chordLibrary;
+            song = settings.selectedSong;
+        }
+    }
+    else
+    {
+        // Saved by a version that stored the mapping as text
+        result = mapping.parseStringSerialization(std::string((const char*)data, (size_t) sizeInBytes));
+    }
+
+    if (result.failed())
+    {
+        // Hosts hand over damaged or foreign data, the current state is kept
+        DBG ("Midilatch: could not load state: " << result.getErrorMessage());
+        return;
+    }
+    // Opening a project must never start overwriting the mapping with whatever is played
+    restoreParameter(ParameterIds::record, 0.0f);
+    // The loaded mapping is only a fallback for a shared set: if another instance
+    // already has the set, its mapping wins
+    setSharedMappingSet({});
+    mappingStore.publish(std::move(mapping));
+    setSharedMappingSet(mappingSet);
+    {
+        // Undoing past a loaded state would mix two projects
+        const RealtimeWatchdog::ScopedLock lock(mappingHistoryLock);
+        mappingHistory.reset(mappingStore.get());
+    }
+
+    // The saved mapping may hold chords recorded on top of the song, so the library is
+    // only reopened for picking the next song, the song is not loaded again
+    const RealtimeWatchdog::ScopedLock lock(chordLibraryLock);
+    chordLibrary.close();
+    selectedSong = {};
+    if (libraryPath.isNotEmpty() && juce::File::isAbsolutePath(libraryPath))
+    {
+        const auto libraryResult = chordLibrary.open(juce::File(libraryPath));
+        if (libraryResult.wasOk())
+        {
+            selectedSong = song;
+        }
+        else
+        {
+            DBG ("Midilatch: could not reopen chord library: " << libraryResult.getErrorMessage());
+        }
+    }
+    stateLoadCount.fetch_add(1);
+}
+
+//==============================================================================
+// This creates new instances of the plugin..
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new MidilatchAudioProcessor();
+}
@@ -1,126 +1,246 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin processor.
-
-  ==============================================================================
-*/
-
-#pragma once
-
-#include <JuceHeader.h>
-#include <set>
-#include <unordered_map>
-#include <optional>
-
-class ActiveNote
-{
-private:
-    int note;
-    int channel;
-    float velocity;
- 
-public:
-    ActiveNote(const int _note, const int _channel, const float _velocity)
-        : note(_note), channel(_channel), velocity(_velocity)
-    {}
-    
-    const int getNote() const { return note; }
-    const int getChannel() const { return channel; }
-    const float getVelocity() const { return velocity; }
-    const juce::MidiMessage makeNoteOn() const { return juce::MidiMessage::noteOn(channel, note, velocity); }
-    const juce::MidiMessage makeNoteOff() const { return juce::MidiMessage::noteOff(channel, note); }
- 
-    // Define an arbitrary comparison so it can be used in a set
-    // Ignore the velocity as it does not make a note unique
-    bool operator<(const ActiveNote& other) const
-    {
-        return (note < other.note) ||
-               (note == other.note && channel < other.channel);
-    }
-};
-
-
-class MidiMapping
-{
-private:
-    // Stores a program change number as key and a vector of notes as value
-    std::map<int, std::vector<int>> noteMap;
-public:
-    MidiMapping();
-    
-    void assign(const int programChange, std::vector<int> notes) { noteMap[programChange] = notes;}
-    const bool contains(const int programChange) const { return noteMap.contains(programChange); }
-    const std::vector<int> getNotes(const int programChange) const;
-    const std::string getDisplayText() const;
-    const std::string getStringSerialization() const;
-    void parseStringSerialization(std::string text);
-    const std::size_t size() const { return noteMap.size();}
-    void transpose(int offset);
-};
-
-
-//==============================================================================
-/**
-*/
-class MidilatchAudioProcessor  : public juce::AudioProcessor
-{
-    public:
-    //==============================================================================
-    MidilatchAudioProcessor();
-    ~MidilatchAudioProcessor() override;
-    
-    //==============================================================================
-    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
-    void releaseResources() override;
-    
-#ifndef JucePlugin_PreferredChannelConfigurations
-    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
-#endif
-    
-    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
-    
-    //==============================================================================
-    juce::AudioProcessorEditor* createEditor() override;
-    bool hasEditor() const override;
-    
-    //==============================================================================
-    const juce::String getName() const override;
-    
-    bool acceptsMidi() const override;
-    bool producesMidi() const override;
-    bool isMidiEffect() const override;
-    double getTailLengthSeconds() const override;
-    
-    //==============================================================================
-    int getNumPrograms() override;
-    int getCurrentProgram() override;
-    void setCurrentProgram (int index) override;
-    const juce::String getProgramName (int index) override;
-    void changeProgramName (int index, const juce::String& newName) override;
-    
-    //==============================================================================
-    void getStateInformation (juce::MemoryBlock& destData) override;
-    void setStateInformation (const void* data, int sizeInBytes) override;
-    
-    std::string getInfo() const;
-    
-    MidiMapping& getMidiMapping() {return midiMapping;}
-    
-    const bool getStoring() const {return isStoring;}
-    void toggleStoring() {isStoring=!isStoring;}
-    void setRepaintFn(std::function<void()> newRepaint) {repaint=newRepaint;}
-    
-    private:
-    std::vector<juce::MidiMessage> activateNote(int note, int channel, float velocity);
-    std::vector<juce::MidiMessage> clearActiveNotes();
-    void tryRepaint() { if(this->repaint.has_value()) { this->repaint.value()();} }
-    
-    //==============================================================================
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidilatchAudioProcessor)
-    std::set<ActiveNote> activeNotes;
-    MidiMapping midiMapping;
-    bool isRecording;
-    bool isStoring;
-    std::optional<std::function<void()>> repaint;
-};
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin processor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChordLibrary.h"
+#include "LatchEngine.h"
+#include "MappingHistory.h"
+#include "MappingLibrary.h"
+#include "MidiMapping.h"
+#include "OutputScheduler.h"
+#include "PerformanceCounters.h"
+#include "RealtimeWatchdog.h"
+#include "StateChangeQueue.h"
+#include "StrumScheduler.h"
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+// IDs of the host parameters, which hosts store automation under, so they never change
+namespace ParameterIds
+{
+    constexpr const char* record = "record";
+    constexpr const char* minimalTransitions = "minimalTransitions";
+    constexpr const char* sharedNotePolicy = "sharedNotePolicy";
+    constexpr const char* latchChannelsSeparately = "latchChannelsSeparately";
+    constexpr const char* mappingChannel = "mappingChannel";
+    constexpr const char* transposeOffset = "transposeOffset";
+    constexpr const char* transposeBounds = "transposeBounds";
+    constexpr const char* chordWindowMs = "chordWindowMs";
+}
+
+//==============================================================================
+/**
+*/
+class MidilatchAudioProcessor  : public juce::AudioProcessor,
+                                 private juce::Timer,
+                                 private MappingLibrary::Subscriber
+{
+    public:
+    //==============================================================================
+    MidilatchAudioProcessor();
+    ~MidilatchAudioProcessor() override;
+    
+    //==============================================================================
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
+    void releaseResources() override;
+    
+#ifndef JucePlugin_PreferredChannelConfigurations
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
+#endif
+    
+    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    
+    //==============================================================================
+    juce::AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override;
+    
+    //==============================================================================
+    const juce::String getName() const override;
+    
+    bool acceptsMidi() const override;
+    bool producesMidi() const override;
+    bool isMidiEffect() const override;
+    double getTailLengthSeconds() const override;
+    
+    //==============================================================================
+    int getNumPrograms() override;
+    int getCurrentProgram() override;
+    void setCurrentProgram (int index) override;
+    const juce::String getProgramName (int index) override;
+    void changeProgramName (int index, const juce::String& newName) override;
+    
+    //==============================================================================
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+    
+    // Names of the latched notes as of the last processed block, safe to call from any thread
+    std::string getInfo() const;
+    std::array<std::uint64_t, 2> getLatchedPitchMask() const { return { latchedPitchMask[0].load(), latchedPitchMask[1].load() }; }
+    
+    // The mapping as last published, for use off the audio thread
+    const MidiMapping& getMidiMapping() const {return mappingStore.get();}
+    MidiMappingStore& getMidiMappingStore() {return mappingStore;}
+    // Publishes a new mapping, and hands it to the other instances sharing its set.
+    // description names the edit in the undo history, e.g. "Import".
+    void publishMapping(MidiMapping mapping, const juce::String& description);
+    
+    // Undo and redo of mapping edits: recorded chords, imports, songs and changes to a
+    // shared set. Loading a state starts a new history. Message thread.
+    bool undoMappingEdit();
+    bool redoMappingEdit();
+    // What undo and redo would revert or repeat, empty if there is nothing to step to
+    juce::String getMappingUndoDescription() const;
+    juce::String getMappingRedoDescription() const;
+    
+    // Instances using the same named mapping set share one mapping, an empty name
+    // keeps the mapping private to this instance. Message thread.
+    void setSharedMappingSet(const juce::String& name);
+    juce::String getSharedMappingSet() const;
+    juce::StringArray getSharedMappingSetNames() const {return mappingLibrary->getSetNames();}
+    // Whether the saved state holds a copy of a shared set, used if the set does not
+    // exist yet when the state is loaded. Otherwise only the set's name is saved.
+    const bool getEmbedSharedMapping() const {return embedSharedMapping.load();}
+    void setEmbedSharedMapping(bool shouldEmbed) {embedSharedMapping.store(shouldEmbed);}
+    
+    // A songbook of mappings, see ChordLibrary. Selecting a song publishes its chords
+    // as the mapping. Message thread (or the host's thread in setStateInformation).
+    juce::Result openChordLibrary(const juce::File& file);
+    juce::File getChordLibraryFile() const;
+    juce::StringArray getChordLibrarySongNames() const;
+    juce::Result selectSong(const juce::String& name);
+    juce::String getSelectedSong() const;
+    
+    // The latch and record settings below are host parameters, so they can be
+    // automated and midi learned. The setters notify the host. Any thread.
+    juce::AudioProcessorValueTreeState& getParameterState() {return parameters;}
+    
+    const bool getStoring() const {return recordParameter->load() >= 0.5f;}
+    void setStoring(bool shouldStore) {setParameter(ParameterIds::record, shouldStore ? 1.0f : 0.0f);}
+    void toggleStoring() {setStoring(!getStoring());}
+    
+    // With minimal transitions, a new chord only releases the notes it does not share
+    // with the latched one and only starts the notes that are not already sounding
+    const bool getMinimalTransitions() const {return minimalTransitionsParameter->load() >= 0.5f;}
+    void setMinimalTransitions(bool shouldBeMinimal) {setParameter(ParameterIds::minimalTransitions, shouldBeMinimal ? 1.0f : 0.0f);}
+    const SharedNotePolicy getSharedNotePolicy() const {return (SharedNotePolicy) juce::roundToInt(sharedNotePolicyParameter->load());}
+    void setSharedNotePolicy(SharedNotePolicy newPolicy) {setParameter(ParameterIds::sharedNotePolicy, (float) newPolicy);}
+    // With separate channels every midi channel latches its own chords, so a new chord
+    // on one channel leaves the others sounding, and program changes fire their chord
+    // on the channel they came in on. Otherwise all channels share one latch and mapped
+    // chords are sent on the mapping channel (1-16).
+    const bool getLatchChannelsSeparately() const {return latchChannelsSeparatelyParameter->load() >= 0.5f;}
+    void setLatchChannelsSeparately(bool shouldBeSeparate) {setParameter(ParameterIds::latchChannelsSeparately, shouldBeSeparate ? 1.0f : 0.0f);}
+    const int getMappingChannel() const {return juce::roundToInt(mappingChannelParameter->load());}
+    void setMappingChannel(int channel) {setParameter(ParameterIds::mappingChannel, (float) juce::jlimit(1, 16, channel));}
+    // Mapped chords are transposed by this many semitones as they are played, the
+    // stored chords are left as they are
+    const int getTransposeOffset() const {return juce::roundToInt(transposeOffsetParameter->load());}
+    void setTransposeOffset(int semitones) {setParameter(ParameterIds::transposeOffset, (float) juce::jlimit(-maxTransposeOffset, maxTransposeOffset, semitones));}
+    const TransposeBounds getTransposeBounds() const {return (TransposeBounds) juce::roundToInt(transposeBoundsParameter->load());}
+    void setTransposeBounds(TransposeBounds newBounds) {setParameter(ParameterIds::transposeBounds, (float) newBounds);}
+    static constexpr int maxTransposeOffset = 127;
+    // With a window, note ons within that many milliseconds of a chord's first note
+    // form the chord, however the keys are released. 0 groups the keys held together.
+    const int getChordWindowMs() const {return juce::roundToInt(chordWindowMsParameter->load());}
+    void setChordWindowMs(int milliseconds) {setParameter(ParameterIds::chordWindowMs, (float) juce::jlimit(0, maxChordWindowMs, milliseconds));}
+    static constexpr int maxChordWindowMs = 1000;
+    // When a latch's chord is a mapped one, the editor highlights its mapping, and with
+    // sendMatchedProgramChanges its bank select and program change are sent on the
+    // latch's mapping channel, so downstream gear can follow what is played. A chord
+    // fired by a program change is not echoed back with the same program change.
+    const ChordMatching getChordMatching() const {return chordMatching.load();}
+    void setChordMatching(ChordMatching newMatching) {chordMatching.store(newMatching);}
+    const bool getSendMatchedProgramChanges() const {return sendMatchedProgramChanges.load();}
+    void setSendMatchedProgramChanges(bool shouldSend) {sendMatchedProgramChanges.store(shouldSend);}
+    // Paces the output to a bytes per second budget, see OutputScheduler
+    OutputScheduler& getOutputScheduler() {return outputScheduler;}
+    // Strums mapped chords and shapes their velocities, see StrumScheduler
+    StrumScheduler& getStrumScheduler() {return strumScheduler;}
+    // Timing and event counts of processBlock, e.g. for benchmarking the processor
+    // without an editor or for the editor's stats panel
+    PerformanceCounters& getPerformanceCounters() {return performanceCounters;}
+    // Drained by the editor's timer while it is open, the audio thread never calls into the editor
+    StateChangeQueue& getStateChanges() {return stateChanges;}
+    // Increases with every state loaded, so the editor knows when settings that aren't
+    // parameters have to be shown anew
+    int getStateLoadCount() const {return stateLoadCount.load();}
+    
+    private:
+    // Connects the latch engine to processedMidi, the mapping and the editor
+    struct EngineHost;
+    void publishLatchedNotes();
+    // Moves the audio thread to the newest mapping snapshot
+    const MidiMapping& acquireMapping();
+    void matchLatchedChord(const ChordIndex& chordIndex, bool recording);
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    // Sets a parameter to a plain (not normalised) value as one gesture
+    void setParameter(const char* parameterId, float value);
+    // Sets a parameter to a plain value loaded from a state, without a gesture, so hosts
+    // don't record it as automation
+    void restoreParameter(const char* parameterId, float value);
+    void notifyEditor(const StateChange& change);
+    void timerCallback() override;
+    void mappingSetChanged(const IndexedMapping& mapping) override;
+    void shareMapping();
+    void recordMappingEdit(const juce::String& description);
+    
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidilatchAudioProcessor)
+    juce::AudioProcessorValueTreeState parameters;
+    // The parameters' plain values, read by the audio thread once per block
+    std::atomic<float>* recordParameter = nullptr;
+    std::atomic<float>* minimalTransitionsParameter = nullptr;
+    std::atomic<float>* sharedNotePolicyParameter = nullptr;
+    std::atomic<float>* latchChannelsSeparatelyParameter = nullptr;
+    std::atomic<float>* mappingChannelParameter = nullptr;
+    std::atomic<float>* transposeOffsetParameter = nullptr;
+    std::atomic<float>* transposeBoundsParameter = nullptr;
+    std::atomic<float>* chordWindowMsParameter = nullptr;
+    // The latched chord in it is only valid for mappingInUse
+    LatchState<MappingEntry> latchState;
+    // Whether latchState.latchOfChannel gives every channel a latch of its own
+    bool latchesSeparate = false;
+    const MidiMapping* mappingInUse = nullptr;
+    // Output of processBlock, reserved in prepareToPlay so the audio thread never grows it
+    juce::MidiBuffer processedMidi;
+    // Bytes of midi one block can put out at most, what processedMidi and the host's
+    // buffer are reserved to
+    size_t reservedMidiBytes = 0;
+    OutputScheduler outputScheduler;
+    StrumScheduler strumScheduler;
+    // Samples processed since prepareToPlay, the scheduler's time base
+    juce::int64 processedSamples = 0;
+    double currentSampleRate = 44100.0;
+    MidiMappingStore mappingStore;
+    // Guards mappingHistory, and is never held while calling out of it
+    RealtimeWatchdog::CriticalSection mappingHistoryLock { "MidilatchAudioProcessor::mappingHistoryLock" };
+    MappingHistory mappingHistory;
+    juce::SharedResourcePointer<MappingLibrary> mappingLibrary;
+    // Guards sharedMappingSet, which the host may set from its own thread via setStateInformation
+    RealtimeWatchdog::CriticalSection sharedMappingSetLock { "MidilatchAudioProcessor::sharedMappingSetLock" };
+    juce::String sharedMappingSet;
+    std::atomic<bool> embedSharedMapping { true };
+    // Guards chordLibrary and selectedSong
+    RealtimeWatchdog::CriticalSection chordLibraryLock { "MidilatchAudioProcessor::chordLibraryLock" };
+    ChordLibrary chordLibrary;
+    juce::String selectedSong;
+    // Filled on the audio thread when a chord is stored, kept here to stay off the stack
+    MidiMappingStore::StoredChord chordToStore;
+    std::atomic<ChordMatching> chordMatching { ChordMatching::off };
+    std::atomic<bool> sendMatchedProgramChanges { false };
+    // The mapping key each latch's chord matched last, only touched by the audio thread
+    std::array<int, LatchedNotes::numChannels> matchedMappingKeys;
+    StateChangeQueue stateChanges;
+    PerformanceCounters performanceCounters;
+    std::atomic<int> stateLoadCount { 0 };
+    std::array<std::atomic<std::uint64_t>, 2> latchedPitchMask {};
+};
@@ -0,0 +1,340 @@
+/*
+  ==============================================================================
+
+    RealtimeWatchdog.cpp
+
+  ==============================================================================
+*/
+
+#include "RealtimeWatchdog.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#if JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+namespace RealtimeWatchdog
+{
+    namespace
+    {
+        // Plain thread locals only, anything that needs construction could allocate
+        thread_local int realtimeDepth = 0;
+        thread_local const char* currentTag = nullptr;
+        thread_local bool isRecording = false;
+
+        // Distinct tag/type pairs, claimed lock-free and never released until reset.
+        // Recording happens inside operator new, so it must not allocate itself.
+        constexpr int maxDistinctViolations = 64;
+
+        struct Slot
+        {
+            std::atomic<const char*> tag { nullptr };
+            std::atomic<int> type { 0 };
+            std::atomic<int> count { 0 };
+        };
+
+        Slot slots[maxDistinctViolations];
+        std::atomic<int> numViolations { 0 };
+
+        void record(ViolationType type)
+        {
+            if (realtimeDepth == 0 || isRecording) { return; }
+            isRecording = true;
+            numViolations.fetch_add(1);
+
+            const char* tag = currentTag != nullptr ? currentTag : "unknown";
+            for (auto& slot : slots)
+            {
+                const char* slotTag = slot.tag.load();
+                if (slotTag == nullptr)
+                {
+                    // Claim the empty slot, or fall through to compare if someone else just did
+                    if (slot.tag.compare_exchange_strong(slotTag, tag))
+                    {
+                        slot.type.store((int) type);
+                        slot.count.fetch_add(1);
+                        break;
+                    }
+                }
+                if (slotTag == tag && slot.type.load() == (int) type)
+                {
+                    slot.count.fetch_add(1);
+                    break;
+                }
+            }
+            isRecording = false;
+        }
+    }
+
+    int getNumViolations()
+    {
+        return numViolations.load();
+    }
+
+    int getViolations(Violation* dest, int maxViolations)
+    {
+        int numCopied = 0;
+        for (auto& slot : slots)
+        {
+            const char* tag = slot.tag.load();
+            if (tag == nullptr || numCopied >= maxViolations) { break; }
+            dest[numCopied++] = { tag, (ViolationType) slot.type.load(), slot.count.load() };
+        }
+        return numCopied;
+    }
+
+    void reset()
+    {
+        for (auto& slot : slots)
+        {
+            slot.count.store(0);
+            slot.type.store(0);
+            slot.tag.store(nullptr);
+        }
+        numViolations.store(0);
+    }
+
+    bool isInRealtimeScope()
+    {
+        return realtimeDepth > 0;
+    }
+
+    void noteLock(const char* lockName)
+    {
+        if (realtimeDepth == 0) { return; }
+        const ScopedTag tag(lockName);
+        record(ViolationType::lock);
+    }
+
+    ScopedRealtime::ScopedRealtime(const char* tag) : previousTag(currentTag)
+    {
+        ++realtimeDepth;
+        currentTag = tag;
+    }
+
+    ScopedRealtime::~ScopedRealtime()
+    {
+        currentTag = previousTag;
+        --realtimeDepth;
+    }
+
+    ScopedTag::ScopedTag(const char* tag) : previousTag(currentTag)
+    {
+        currentTag = tag;
+    }
+
+    ScopedTag::~ScopedTag()
+    {
+        currentTag = previousTag;
+    }
+}
+
+#if MIDILATCH_REALTIME_WATCHDOG
+
+#if MIDILATCH_REALTIME_WATCHDOG_MALLOC && defined (__GLIBC__)
+ #define MIDILATCH_REALTIME_WATCHDOG_REPLACES_MALLOC 1
+#else
+ #define MIDILATCH_REALTIME_WATCHDOG_REPLACES_MALLOC 0
+#endif
+
+#if MIDILATCH_REALTIME_WATCHDOG_REPLACES_MALLOC
+// glibc's own allocator stays reachable under these names. Only for executables: the
+// thread locals read here live in the executable's static TLS block, so reading them
+// never allocates, which a shared library's could.
+extern "C" void* __libc_malloc (std::size_t);
+extern "C" void* __libc_calloc (std::size_t, std::size_t);
+extern "C" void* __libc_realloc (void*, std::size_t);
+extern "C" void __libc_free (void*);
+
+extern "C" void* malloc (std::size_t size) noexcept
+{
+    RealtimeWatchdog::record(RealtimeWatchdog::ViolationType::allocation);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc (std::size_t count, std::size_t size) noexcept
+{
+    RealtimeWatchdog::record(RealtimeWatchdog::ViolationType::allocation);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc (void* memory, std::size_t size) noexcept
+{
+    // Growing in place is still a call into the allocator, which may take its lock
+    RealtimeWatchdog::record(size == 0 ? RealtimeWatchdog::ViolationType::deallocation : RealtimeWatchdog::ViolationType::allocation);
+    return __libc_realloc(memory, size);
+}
+
+extern "C" void free (void* memory) noexcept
+{
+    if (memory == nullptr) { return; }
+    RealtimeWatchdog::record(RealtimeWatchdog::ViolationType::deallocation);
+    __libc_free(memory);
+}
+#endif
+
+namespace
+{
+    // The allocator underneath operator new and delete, without recording again when
+    // malloc and free already record
+    void* allocate(std::size_t size) noexcept
+    {
+       #if MIDILATCH_REALTIME_WATCHDOG_REPLACES_MALLOC
+        return __libc_malloc(size);
+       #else
+        return std::malloc(size);
+       #endif
+    }
+
+    void deallocate(void* memory) noexcept
+    {
+       #if MIDILATCH_REALTIME_WATCHDOG_REPLACES_MALLOC
+        __libc_free(memory);
+       #else
+        std::free(memory);
+       #endif
+    }
+}
+
+void* operator new (std::size_t size)
+{
+    RealtimeWatchdog::record(RealtimeWatchdog::ViolationType::allocation);
+    if (void* memory = allocate(size == 0 ? 1 : size))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    return operator new (size);
+}
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept
+{
+    RealtimeWatchdog::record(RealtimeWatchdog::ViolationType::allocation);
+    return allocate(size == 0 ? 1 : size);
+}
+
+void* operator new[] (std::size_t size, const std::nothrow_t& nothrow) noexcept
+{
+    return operator new (size, nothrow);
+}
+
+void operator delete (void* memory) noexcept
+{
+    if (memory == nullptr) { return; }
+    RealtimeWatchdog::record(RealtimeWatchdog::ViolationType::deallocation);
+    deallocate(memory);
+}
+
+void operator delete[] (void* memory) noexcept
+{
+    operator delete (memory);
+}
+
+void operator delete (void* memory, std::size_t) noexcept
+{
+    operator delete (memory);
+}
+
+void operator delete[] (void* memory, std::size_t) noexcept
+{
+    operator delete (memory);
+}
+
+void operator delete (void* memory, const std::nothrow_t&) noexcept
+{
+    operator delete (memory);
+}
+
+void operator delete[] (void* memory, const std::nothrow_t&) noexcept
+{
+    operator delete (memory);
+}
+
+//==============================================================================
+// Over-aligned types (alignas beyond the default new alignment) come through these
+namespace
+{
+    void* allocateAligned(std::size_t size, std::align_val_t alignment) noexcept
+    {
+        RealtimeWatchdog::record(RealtimeWatchdog::ViolationType::allocation);
+        const auto align = juce::jmax((std::size_t) alignment, sizeof(void*));
+       #if JUCE_WINDOWS
+        return _aligned_malloc(size == 0 ? 1 : size, align);
+       #else
+        void* memory = nullptr;
+        return posix_memalign(&memory, align, size == 0 ? 1 : size) == 0 ? memory : nullptr;
+       #endif
+    }
+
+    void freeAligned(void* memory) noexcept
+    {
+        if (memory == nullptr) { return; }
+        RealtimeWatchdog::record(RealtimeWatchdog::ViolationType::deallocation);
+       #if JUCE_WINDOWS
+        _aligned_free(memory);
+       #else
+        deallocate(memory);
+       #endif
+    }
+}
+
+void* operator new (std::size_t size, std::align_val_t alignment)
+{
+    if (void* memory = allocateAligned(size, alignment))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size, std::align_val_t alignment)
+{
+    return operator new (size, alignment);
+}
+
+void* operator new (std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[] (std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete (void* memory, std::align_val_t) noexcept
+{
+    freeAligned(memory);
+}
+
+void operator delete[] (void* memory, std::align_val_t) noexcept
+{
+    freeAligned(memory);
+}
+
+void operator delete (void* memory, std::size_t, std::align_val_t) noexcept
+{
+    freeAligned(memory);
+}
+
+void operator delete[] (void* memory, std::size_t, std::align_val_t) noexcept
+{
+    freeAligned(memory);
+}
+
+void operator delete (void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    freeAligned(memory);
+}
+
+void operator delete[] (void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    freeAligned(memory);
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+  ==============================================================================
+
+    RealtimeWatchdog.h
+    A debug build mode that catches heap use and locking on the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Define MIDILATCH_REALTIME_WATCHDOG=1 (e.g. in the Projucer's preprocessor definitions
+// of a debug configuration) to enable it. The global operator new and delete are then
+// replaced, aligned forms included, and any allocation, deallocation or lock that
+// happens on a thread while it is inside MIDILATCH_REALTIME_SCOPE is recorded against
+// the innermost tag.
+//
+// Inside a plugin malloc can't be intercepted portably, so memory JUCE takes straight
+// from malloc and realloc (MidiBuffer, HeapBlock, Array growth) goes unseen. Executables
+// built against glibc, such as midilatch-render, can also define
+// MIDILATCH_REALTIME_WATCHDOG_MALLOC=1 to replace malloc, calloc, realloc and free
+// themselves, which catches those too.
+//
+// Only locks taken through RealtimeWatchdog::CriticalSection are seen. The plugin uses
+// it for all of its own locks; locks taken inside JUCE, the standard library or the
+// host are not recorded.
+//
+// When the flag is off, all the macros compile to nothing and CriticalSection is a
+// plain juce::CriticalSection.
+#ifndef MIDILATCH_REALTIME_WATCHDOG
+ #define MIDILATCH_REALTIME_WATCHDOG 0
+#endif
+#ifndef MIDILATCH_REALTIME_WATCHDOG_MALLOC
+ #define MIDILATCH_REALTIME_WATCHDOG_MALLOC 0
+#endif
+
+namespace RealtimeWatchdog
+{
+    enum class ViolationType
+    {
+        allocation,
+        deallocation,
+        lock
+    };
+
+    struct Violation
+    {
+        const char* tag;
+        ViolationType type;
+        int count;
+    };
+
+    // Total number of violations since the last reset
+    int getNumViolations();
+    // Copies up to maxViolations distinct tag/type pairs into dest, returns how many were copied
+    int getViolations(Violation* dest, int maxViolations);
+    void reset();
+
+    bool isInRealtimeScope();
+    // Records a lock taken inside a real-time scope, tagged with lockName
+    void noteLock(const char* lockName);
+
+    // A juce::CriticalSection that reports every enter to the watchdog under its name
+    class CriticalSection
+    {
+    public:
+        explicit CriticalSection(const char* lockName) noexcept : name(lockName) {}
+
+        void enter() const noexcept
+        {
+           #if MIDILATCH_REALTIME_WATCHDOG
+            noteLock(name);
+           #endif
+            lock.enter();
+        }
+        bool tryEnter() const noexcept
+        {
+           #if MIDILATCH_REALTIME_WATCHDOG
+            noteLock(name);
+           #endif
+            return lock.tryEnter();
+        }
+        void exit() const noexcept { lock.exit(); }
+
+    private:
+        juce::CriticalSection lock;
+        [[maybe_unused]] const char* name;
+        JUCE_DECLARE_NON_COPYABLE (CriticalSection)
+    };
+
+    using ScopedLock = juce::GenericScopedLock<CriticalSection>;
+
+    // Marks the current thread as real-time for its lifetime
+    class ScopedRealtime
+    {
+    public:
+        explicit ScopedRealtime(const char* tag);
+        ~ScopedRealtime();
+
+    private:
+        const char* previousTag;
+        JUCE_DECLARE_NON_COPYABLE (ScopedRealtime)
+    };
+
+    // Narrows down which part of a real-time scope a violation came from
+    class ScopedTag
+    {
+    public:
+        explicit ScopedTag(const char* tag);
+        ~ScopedTag();
+
+    private:
+        const char* previousTag;
+        JUCE_DECLARE_NON_COPYABLE (ScopedTag)
+    };
+}
+
+#if MIDILATCH_REALTIME_WATCHDOG
+ #define MIDILATCH_REALTIME_SCOPE(tag) const RealtimeWatchdog::ScopedRealtime JUCE_JOIN_MACRO (realtimeScope, __LINE__) (tag)
+ #define MIDILATCH_REALTIME_TAG(tag) const RealtimeWatchdog::ScopedTag JUCE_JOIN_MACRO (realtimeTag, __LINE__) (tag)
+#else
+ #define MIDILATCH_REALTIME_SCOPE(tag)
+ #define MIDILATCH_REALTIME_TAG(tag)
+#endif
@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    StateChangeQueue.h
+    Compact records of what the audio thread changed, handed to the editor
+    through a single producer / single consumer ring buffer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+struct StateChange
+{
+    enum class Type : juce::uint8
+    {
+        latchedNotes,   // the latched set changed, latchedNotes holds the new pitch mask
+        programChange,  // the chord mapped to mappingKey was fired
+        chordStored,    // the latched chord was recorded for mappingKey
+        chordMatched,   // the latched chord is the one mapped to mappingKey
+        matchLost       // a latch released or changed the chord that matched mappingKey
+    };
+
+    Type type = Type::latchedNotes;
+    // Bank and program, see MidiMapping::makeKey
+    int mappingKey = 0;
+    // One bit per midi note, set if the note is latched on any channel
+    std::array<std::uint64_t, 2> latchedNotes {};
+};
+
+// The audio thread pushes, the editor drains on a timer. Neither side blocks or
+// allocates: a push is a copy into a preallocated slot plus the fifo's atomic updates.
+class StateChangeQueue
+{
+public:
+    // Audio thread only. If the queue is full the change is dropped and the
+    // overflow is remembered, so the reader knows to refresh everything.
+    bool push(const StateChange& change)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+        if (size1 + size2 == 0)
+        {
+            overflowed.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        buffer[(size_t) (size1 > 0 ? start1 : start2)] = change;
+        fifo.finishedWrite(1);
+        return true;
+    }
+
+    // Reader thread only. Calls fn for every pending change in order, returns how many there were.
+    template <typename Fn>
+    int drain(Fn&& fn)
+    {
+        const int numReady = fifo.getNumReady();
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(numReady, start1, size1, start2, size2);
+        for (int i = start1; i < start1 + size1; ++i) { fn(buffer[(size_t) i]); }
+        for (int i = start2; i < start2 + size2; ++i) { fn(buffer[(size_t) i]); }
+        fifo.finishedRead(size1 + size2);
+        return size1 + size2;
+    }
+
+    // Reader thread only. True if changes were dropped since the last call.
+    bool getAndClearOverflow() { return overflowed.exchange(false, std::memory_order_relaxed); }
+
+    // Changes are only worth pushing while a reader drains them, otherwise the queue
+    // just fills up. The reader attaches and detaches itself, the audio thread checks.
+    void setReaderAttached(bool isAttached) { readerAttached.store(isAttached); }
+    bool isReaderAttached() const { return readerAttached.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int capacity = 256;
+
+    juce::AbstractFifo fifo { capacity };
+    std::array<StateChange, capacity> buffer;
+    std::atomic<bool> overflowed { false };
+    std::atomic<bool> readerAttached { false };
+};
@@ -0,0 +1,235 @@
+/*
+  ==============================================================================
+
+    StateFormat.cpp
+
+  ==============================================================================
+*/
+
+#include "StateFormat.h"
+
+namespace StateFormat
+{
+    namespace
+    {
+        const char magic[4] = { 'M', 'L', 'C', 'H' };
+
+        constexpr juce::uint32 fnvOffsetBasis = 2166136261u;
+        constexpr juce::uint32 fnvPrime = 16777619u;
+
+        juce::uint32 updateChecksum(juce::uint32 checksum, const juce::uint8* data, size_t size)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                checksum = (checksum ^ data[i]) * fnvPrime;
+            }
+            return checksum;
+        }
+
+        // Reads little endian values and checksums them on the way
+        struct Reader
+        {
+            const juce::uint8* data;
+            size_t size;
+            size_t position = 0;
+            juce::uint32 checksum = fnvOffsetBasis;
+
+            bool canRead(size_t numBytes) const { return size - position >= numBytes; }
+            const juce::uint8* take(size_t numBytes)
+            {
+                const auto* start = data + position;
+                checksum = updateChecksum(checksum, start, numBytes);
+                position += numBytes;
+                return start;
+            }
+            juce::uint8 readByte() { return *take(1); }
+            juce::uint16 readShort() { return juce::ByteOrder::littleEndianShort(take(2)); }
+            juce::uint32 readInt() { return juce::ByteOrder::littleEndianInt(take(4)); }
+            // A uint16 length and that many bytes of utf-8, false if it runs past the end
+            bool readString(juce::String& text)
+            {
+                if (!canRead(2)) { return false; }
+                const size_t textSize = readShort();
+                if (!canRead(textSize)) { return false; }
+                text = juce::String::fromUTF8((const char*) take(textSize), (int) textSize);
+                return true;
+            }
+        };
+
+        void appendShort(juce::MemoryBlock& block, juce::uint16 value)
+        {
+            const juce::uint8 bytes[] = { (juce::uint8) value, (juce::uint8) (value >> 8) };
+            block.append(bytes, sizeof(bytes));
+        }
+
+        void appendInt(juce::MemoryBlock& block, juce::uint32 value)
+        {
+            const juce::uint8 bytes[] = { (juce::uint8) value, (juce::uint8) (value >> 8), (juce::uint8) (value >> 16), (juce::uint8) (value >> 24) };
+            block.append(bytes, sizeof(bytes));
+        }
+
+        // Strings longer than 65535 bytes are cut off
+        void appendString(juce::MemoryBlock& block, const juce::String& text)
+        {
+            const size_t size = juce::jmin(text.getNumBytesAsUTF8(), (size_t) 0xffff);
+            appendShort(block, (juce::uint16) size);
+            block.append(text.toRawUTF8(), size);
+        }
+
+        void writeInt(juce::uint8* dest, juce::uint32 value)
+        {
+            for (int i = 0; i < 4; ++i) { dest[i] = (juce::uint8) (value >> (8 * i)); }
+        }
+    }
+
+    bool isBinary(const void* data, size_t size)
+    {
+        return size >= sizeof(magic) && std::memcmp(data, magic, sizeof(magic)) == 0;
+    }
+
+    void write(const MidiMapping& mapping, const Settings& settings, juce::MemoryBlock& destData)
+    {
+        juce::MemoryBlock block;
+        block.append(magic, sizeof(magic));
+        appendShort(block, (juce::uint16) currentVersion);
+        appendShort(block, (juce::uint16) headerSize);
+        // Payload size and checksum are filled in at the end
+        appendInt(block, 0);
+        appendInt(block, 0);
+
+        const juce::uint8 flags = (juce::uint8) ((settings.minimalTransitions ? 1 : 0) | (settings.latchChannelsSeparately ? 2 : 0)
+                                                 | (settings.embedsMapping ? 0 : 4));
+        const juce::uint8 chordMatching = (juce::uint8) ((settings.chordMatching & 3) | (settings.sendMatchedProgramChanges ? 4 : 0));
+        const juce::uint8 settingBytes[] = { flags, (juce::uint8) settings.sharedNotePolicy, (juce::uint8) settings.mappingChannel, chordMatching };
+        block.append(settingBytes, sizeof(settingBytes));
+        appendInt(block, (juce::uint32) settings.outputBytesPerSecond);
+        const juce::uint8 transposeBytes[] = { (juce::uint8) (juce::int8) settings.transposeOffset, (juce::uint8) settings.transposeBounds };
+        block.append(transposeBytes, sizeof(transposeBytes));
+        appendShort(block, 0);
+        appendString(block, settings.sharedMappingSet);
+        appendString(block, settings.chordLibrary);
+        appendString(block, settings.selectedSong);
+        const juce::uint8 strumBytes[] = { (juce::uint8) settings.strumDirection, (juce::uint8) settings.firstChordVelocity,
+                                           (juce::uint8) settings.lastChordVelocity, 0 };
+        block.append(strumBytes, sizeof(strumBytes));
+        appendShort(block, (juce::uint16) settings.strumSpreadMs);
+        appendShort(block, (juce::uint16) settings.chordWindowMs);
+        appendInt(block, (juce::uint32) mapping.size());
+        mapping.forEach([&block](int key, const std::vector<int>& notes)
+        {
+            appendInt(block, (juce::uint32) key);
+            appendShort(block, (juce::uint16) notes.size());
+            for (int note : notes)
+            {
+                const juce::uint8 byte = (juce::uint8) note;
+                block.append(&byte, 1);
+            }
+        });
+
+        auto* bytes = static_cast<juce::uint8*>(block.getData());
+        const size_t payloadSize = block.getSize() - headerSize;
+        writeInt(bytes + 8, (juce::uint32) payloadSize);
+        writeInt(bytes + 12, updateChecksum(fnvOffsetBasis, bytes + headerSize, payloadSize));
+        destData.append(block.getData(), block.getSize());
+    }
+
+    juce::Result read(const void* data, size_t size, MidiMapping& mapping, Settings& settings)
+    {
+        const auto* bytes = static_cast<const juce::uint8*>(data);
+        if (size < (size_t) headerSize || !isBinary(data, size))
+        {
+            return juce::Result::fail("Not a Midilatch state");
+        }
+        const int version = juce::ByteOrder::littleEndianShort(bytes + 4);
+        const size_t storedHeaderSize = juce::ByteOrder::littleEndianShort(bytes + 6);
+        const size_t payloadSize = juce::ByteOrder::littleEndianInt(bytes + 8);
+        const juce::uint32 storedChecksum = juce::ByteOrder::littleEndianInt(bytes + 12);
+        if (version < 1)
+        {
+            // No version ever wrote 0
+            return juce::Result::fail("State is corrupt: invalid format version");
+        }
+        if (version > currentVersion)
+        {
+            return juce::Result::fail("State was saved by a newer version of Midilatch");
+        }
+        if (storedHeaderSize < (size_t) headerSize || storedHeaderSize > size || size - storedHeaderSize != payloadSize)
+        {
+            return juce::Result::fail("State is truncated or has the wrong size");
+        }
+
+        Reader reader { bytes + storedHeaderSize, payloadSize };
+        // Fixed size settings and the entry count
+        if (!reader.canRead(version >= 2 ? 16 : 12))
+        {
+            return juce::Result::fail("State is truncated");
+        }
+        Settings readSettings;
+        const int flags = reader.readByte();
+        readSettings.minimalTransitions = (flags & 1) != 0;
+        readSettings.latchChannelsSeparately = (flags & 2) != 0;
+        readSettings.sharedNotePolicy = reader.readByte();
+        const int mappingChannel = reader.readByte();
+        readSettings.mappingChannel = mappingChannel >= 1 && mappingChannel <= 16 ? mappingChannel : 1;
+        const int chordMatching = reader.readByte();
+        readSettings.chordMatching = chordMatching & 3;
+        readSettings.sendMatchedProgramChanges = (chordMatching & 4) != 0;
+        readSettings.outputBytesPerSecond = (int) reader.readInt();
+        if (version >= 2)
+        {
+            readSettings.transposeOffset = (juce::int8) reader.readByte();
+            readSettings.transposeBounds = reader.readByte();
+            reader.readShort();
+        }
+        if ((version >= 3 && !reader.readString(readSettings.sharedMappingSet))
+            || (version >= 4 && !(reader.readString(readSettings.chordLibrary) && reader.readString(readSettings.selectedSong)))
+            || !reader.canRead(version >= 5 ? 12 : 4))
+        {
+            return juce::Result::fail("State is truncated");
+        }
+        if (version >= 5)
+        {
+            readSettings.strumDirection = reader.readByte();
+            readSettings.firstChordVelocity = reader.readByte();
+            readSettings.lastChordVelocity = reader.readByte();
+            reader.readByte();
+            readSettings.strumSpreadMs = reader.readShort();
+            readSettings.chordWindowMs = reader.readShort();
+        }
+        readSettings.embedsMapping = (flags & 4) == 0;
+        const juce::uint32 numEntries = reader.readInt();
+
+        MidiMapping readMapping;
+        for (juce::uint32 i = 0; i < numEntries; ++i)
+        {
+            if (!reader.canRead(6))
+            {
+                return juce::Result::fail("State is truncated");
+            }
+            const juce::uint32 key = reader.readInt();
+            const size_t numNotes = reader.readShort();
+            if (key >= (juce::uint32) MidiMapping::numKeys || !reader.canRead(numNotes))
+            {
+                return juce::Result::fail("State contains an invalid mapping entry");
+            }
+            const auto* notes = reader.take(numNotes);
+            if (std::any_of(notes, notes + numNotes, [](juce::uint8 note) { return note > 127; }))
+            {
+                return juce::Result::fail("State contains a note out of range");
+            }
+            readMapping.assign((int) key, std::vector<int>(notes, notes + numNotes));
+        }
+        if (reader.position != payloadSize)
+        {
+            return juce::Result::fail("State has trailing data");
+        }
+        if (reader.checksum != storedChecksum)
+        {
+            return juce::Result::fail("State checksum does not match");
+        }
+
+        mapping = std::move(readMapping);
+        settings = readSettings;
+        return juce::Result::ok();
+    }
+}
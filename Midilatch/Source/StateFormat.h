@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    StateFormat.h
+    The binary format the plugin state is saved in.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "MidiMapping.h"
+
+// All values little endian.
+//
+//   Header (16 bytes)
+//     char[4]  magic "MLCH"
+//     uint16   format version
+//     uint16   header size, so later versions can append header fields
+//     uint32   payload size
+//     uint32   FNV-1a checksum of the payload
+//   Payload
+//     uint8    flags (bit 0: minimal transitions, bit 1: latch channels separately,
+//                     bit 2: the mapping of a shared set is not embedded,
+//                     bit 3: reserved, record mode in some version 5 states; ignored,
+//                            a loaded state always starts with record mode off)
+//     uint8    shared note policy
+//     uint8    mapping channel 1-16, 0 for the default of 1
+//     uint8    chord matching (bits 0-1: mode, bit 2: send program changes),
+//              reserved before and so 0 (off) in older states
+//     uint32   output pacing in bytes per second, 0 for none
+//     int8     transpose offset in semitones           (version 2 and later)
+//     uint8    transpose bounds                        (version 2 and later)
+//     uint16   reserved                                (version 2 and later)
+//     uint16   length of the shared mapping set name   (version 3 and later)
+//     char[]   shared mapping set name, utf-8, empty for a private mapping
+//     uint16   length of the chord library path            (version 4 and later)
+//     char[]   chord library path, utf-8, empty for none
+//     uint16   length of the selected song's name          (version 4 and later)
+//     char[]   selected song, utf-8
+//     uint8    strum direction                              (version 5 and later)
+//     uint8    velocity of a mapped chord's first note      (version 5 and later)
+//     uint8    velocity of a mapped chord's last note       (version 5 and later)
+//     uint8    reserved                                     (version 5 and later)
+//     uint16   strum spread in milliseconds                 (version 5 and later)
+//     uint16   chord capture window in milliseconds, 0 for held keys,
+//              reserved before and so 0 in older states     (version 5 and later)
+//     uint32   number of mapping entries
+//     per entry: uint32 mapping key, uint16 number of notes, uint8 notes[]
+//
+// Blobs that don't start with the magic are read as the text serialization older
+// versions of the plugin saved.
+namespace StateFormat
+{
+    constexpr int currentVersion = 5;
+    constexpr int headerSize = 16;
+
+    // Plugin settings saved alongside the mapping, most of them the host parameters
+    struct Settings
+    {
+        bool minimalTransitions = false;
+        int sharedNotePolicy = 0;
+        bool latchChannelsSeparately = false;
+        int mappingChannel = 1;
+        int transposeOffset = 0;
+        int transposeBounds = 0;
+        int chordWindowMs = 0;
+        // The named set the mapping is shared through, see MappingLibrary. Without
+        // embedsMapping the saved mapping is empty and the set has to provide it.
+        juce::String sharedMappingSet;
+        bool embedsMapping = true;
+        // The songbook the mapping was picked from, see ChordLibrary
+        juce::String chordLibrary;
+        juce::String selectedSong;
+        int outputBytesPerSecond = 0;
+        int chordMatching = 0;
+        // See StrumScheduler
+        int strumDirection = 0;
+        int strumSpreadMs = 0;
+        int firstChordVelocity = 127;
+        int lastChordVelocity = 127;
+        bool sendMatchedProgramChanges = false;
+    };
+
+    bool isBinary(const void* data, size_t size);
+    void write(const MidiMapping& mapping, const Settings& settings, juce::MemoryBlock& destData);
+    // Reads a binary blob in a single pass. mapping and settings are only assigned if the
+    // whole blob is valid and its checksum matches.
+    juce::Result read(const void* data, size_t size, MidiMapping& mapping, Settings& settings);
+}
@@ -0,0 +1,104 @@
+/*
+  ==============================================================================
+
+    StrumScheduler.cpp
+
+  ==============================================================================
+*/
+
+#include "StrumScheduler.h"
+#include <bit>
+
+void StrumScheduler::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    reset();
+}
+
+void StrumScheduler::reset()
+{
+    count = 0;
+    chordNotes = {};
+}
+
+void StrumScheduler::addChordNote(int channelIndex, int note)
+{
+    chordChannelIndex = channelIndex;
+    chordNotes[(size_t) (note >> 6)] |= std::uint64_t(1) << (note & 63);
+}
+
+double StrumScheduler::getPosition(const std::array<std::uint64_t, 2>& chord, int note) const
+{
+    const int numNotes = std::popcount(chord[0]) + std::popcount(chord[1]);
+    if (numNotes < 2) { return 0.0; }
+    const auto below = [](std::uint64_t word, int bits) { return bits >= 64 ? word : word & ((std::uint64_t(1) << bits) - 1); };
+    const int notesBelow = std::popcount(below(chord[0], note)) + (note > 64 ? std::popcount(below(chord[1], note - 64)) : 0);
+    const int rank = direction.load(std::memory_order_relaxed) == Direction::up ? notesBelow : numNotes - 1 - notesBelow;
+    // Both spread evenly from the first note to the last
+    return (double) juce::jlimit(0, numNotes - 1, rank) / (numNotes - 1);
+}
+
+juce::uint8 StrumScheduler::getVelocity(double position) const
+{
+    const int first = firstVelocity.load(std::memory_order_relaxed);
+    const int last = lastVelocity.load(std::memory_order_relaxed);
+    return (juce::uint8) juce::jlimit(1, 127, juce::roundToInt(first + (last - first) * position));
+}
+
+juce::uint8 StrumScheduler::getChordVelocity(const std::array<std::uint64_t, 2>& chord, int note) const
+{
+    return getVelocity(getPosition(chord, note));
+}
+
+void StrumScheduler::startChord(const std::array<std::uint64_t, 2>& chord, juce::MidiBuffer& output, juce::int64 blockStart, int samplePosition)
+{
+    const double spreadSamples = spreadMs.load(std::memory_order_relaxed) * sampleRate / 1000.0;
+    const bool up = direction.load(std::memory_order_relaxed) == Direction::up;
+
+    for (int i = 0; i < 128; ++i)
+    {
+        const int note = up ? i : 127 - i;
+        if (!((chordNotes[(size_t) (note >> 6)] >> (note & 63)) & 1)) { continue; }
+        const double position = getPosition(chord, note);
+        const auto velocity = getVelocity(position);
+        const auto delay = (juce::int64) juce::roundToInt(spreadSamples * position);
+        if (delay == 0 || count == capacity)
+        {
+            const juce::uint8 noteOn[] = { (juce::uint8) (0x90 | chordChannelIndex), (juce::uint8) note, velocity };
+            output.addEvent(noteOn, 3, samplePosition);
+            continue;
+        }
+        pending[(size_t) count++] = { blockStart + samplePosition + delay, (juce::uint8) chordChannelIndex, (juce::uint8) note, velocity };
+    }
+    chordNotes = {};
+}
+
+bool StrumScheduler::release(int channelIndex, int note, juce::int64 time)
+{
+    // A note on due before the note off goes out before it at the end of the block. One
+    // due at the same sample or later never starts: written after the note off, it would
+    // hang.
+    for (int i = count - 1; i >= 0; --i)
+    {
+        const auto& waiting = pending[(size_t) i];
+        if (waiting.channelIndex == channelIndex && waiting.note == note && waiting.time >= time)
+        {
+            remove(i);
+            return false;
+        }
+    }
+    return true;
+}
+
+void StrumScheduler::process(juce::MidiBuffer& output, juce::int64 blockStart, int numSamples)
+{
+    const juce::int64 blockEnd = blockStart + numSamples;
+    for (int i = count - 1; i >= 0; --i)
+    {
+        const auto& waiting = pending[(size_t) i];
+        if (waiting.time >= blockEnd) { continue; }
+        const juce::uint8 noteOn[] = { (juce::uint8) (0x90 | waiting.channelIndex), waiting.note, waiting.velocity };
+        output.addEvent(noteOn, 3, (int) juce::jmax((juce::int64) 0, waiting.time - blockStart));
+        remove(i);
+    }
+}
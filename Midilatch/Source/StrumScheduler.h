@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    StrumScheduler.h
+    Strums mapped chords: spreads their note ons over time and shapes their
+    velocities, carrying delayed notes over to the following blocks.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+// A mapped chord normally starts all its notes at the same sample with full velocity.
+// With a spread, its notes start one after the other, lowest or highest first, the
+// last one spread milliseconds after the first, and their velocities ramp from the
+// first note's to the last note's. A note's place in the strum is its place in the
+// whole chord, so a note gets the same velocity and delay whether the chord starts
+// from silence or only starts the notes a minimal transition is missing.
+//
+// Notes that start in a later sample wait in a fixed size queue timed in samples since
+// prepare, and go out sample accurately in whichever block they fall into. A note off
+// for a note that is still waiting cancels both, so a chord replaced before it finished
+// strumming never starts its remaining notes, and an all notes off cancels every
+// waiting note of the channels it releases. The audio thread never allocates; if the
+// queue is full, notes start unstrummed rather than being dropped.
+class StrumScheduler
+{
+public:
+    static constexpr int capacity = 256;
+    static constexpr int maxSpreadMs = 1000;
+
+    enum class Direction : juce::uint8
+    {
+        up,     // lowest note first
+        down    // highest note first
+    };
+
+    // Audio thread, or while it is stopped
+    void prepare(double newSampleRate);
+    void reset();
+
+    // Any thread
+    void setDirection(Direction newDirection) { direction.store(newDirection); }
+    Direction getDirection() const { return direction.load(); }
+    void setSpreadMs(int newSpreadMs) { spreadMs.store(juce::jlimit(0, maxSpreadMs, newSpreadMs)); }
+    int getSpreadMs() const { return spreadMs.load(); }
+    // Velocities of the first and the last note of a chord, 1-127
+    void setVelocities(int first, int last) { firstVelocity.store(juce::jlimit(1, 127, first)); lastVelocity.store(juce::jlimit(1, 127, last)); }
+    int getFirstVelocity() const { return firstVelocity.load(); }
+    int getLastVelocity() const { return lastVelocity.load(); }
+
+    //==============================================================================
+    // Audio thread only
+
+    // True if mapped chords have to be started through addChordNote and startChord
+    // instead of with their prebuilt note ons. Read once per block, so a chord is never
+    // half strummed when the settings change.
+    bool isActive() const
+    {
+        return spreadMs.load(std::memory_order_relaxed) > 0 || firstVelocity.load(std::memory_order_relaxed) != 127
+            || lastVelocity.load(std::memory_order_relaxed) != 127;
+    }
+    bool hasPendingNotes() const { return count > 0; }
+
+    // The velocity note starts with as part of chord (one bit per note)
+    juce::uint8 getChordVelocity(const std::array<std::uint64_t, 2>& chord, int note) const;
+    // Collects a note of the chord about to be started. Notes of a chord all go out on
+    // the same channel, and each note at most once.
+    void addChordNote(int channelIndex, int note);
+    // Writes the collected notes that start right away to output and queues the rest,
+    // placed in the strum of chord, which holds at least the collected notes. blockStart
+    // is the time of sample 0 of output in samples since prepare.
+    void startChord(const std::array<std::uint64_t, 2>& chord, juce::MidiBuffer& output, juce::int64 blockStart, int samplePosition);
+    // Called for a note off at time. Returns false if the note's note on was still
+    // waiting, in which case it is dropped and the note off must not be sent either.
+    bool release(int channelIndex, int note, juce::int64 time);
+    // Drops every waiting note on a channel for which isReleased(channelIndex) holds
+    template <typename Predicate>
+    void cancelChannels(Predicate&& isReleased)
+    {
+        for (int i = count - 1; i >= 0; --i)
+        {
+            if (isReleased((int) pending[(size_t) i].channelIndex)) { remove(i); }
+        }
+    }
+    // Writes the waiting notes that fall into this block to output
+    void process(juce::MidiBuffer& output, juce::int64 blockStart, int numSamples);
+
+private:
+    struct PendingNote
+    {
+        juce::int64 time;
+        juce::uint8 channelIndex, note, velocity;
+    };
+
+    void remove(int index) { pending[(size_t) index] = pending[(size_t) --count]; }
+    // Where note falls in the strum of chord, 0 for the first note to 1 for the last
+    double getPosition(const std::array<std::uint64_t, 2>& chord, int note) const;
+    juce::uint8 getVelocity(double position) const;
+
+    std::atomic<Direction> direction { Direction::up };
+    std::atomic<int> spreadMs { 0 };
+    std::atomic<int> firstVelocity { 127 };
+    std::atomic<int> lastVelocity { 127 };
+    double sampleRate = 44100.0;
+
+    // Unordered, it is short and scanned once per block
+    std::array<PendingNote, capacity> pending;
+    int count = 0;
+
+    // The chord being collected, one bit per note
+    std::array<std::uint64_t, 2> chordNotes {};
+    int chordChannelIndex = 0;
+};
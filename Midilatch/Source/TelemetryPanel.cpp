@@ -0,0 +1,42 @@
+/*
+  ==============================================================================
+
+    TelemetryPanel.cpp
+
+  ==============================================================================
+*/
+
+#include "TelemetryPanel.h"
+
+TelemetryPanel::TelemetryPanel(PerformanceCounters& c)
+    : counters(c), copyButton("Copy snapshot"), resetButton("Reset")
+{
+    statsText.setMultiLine(true);
+    statsText.setReadOnly(true);
+    statsText.setScrollbarsShown(true);
+    addAndMakeVisible(statsText);
+
+    copyButton.onClick = [this]{
+        juce::SystemClipboard::copyTextToClipboard(this->counters.getSnapshot().toText());
+    };
+    addAndMakeVisible(copyButton);
+
+    resetButton.onClick = [this]{
+        this->counters.reset();
+    };
+    addAndMakeVisible(resetButton);
+}
+
+void TelemetryPanel::refresh()
+{
+    statsText.setText(counters.getSnapshot().toText());
+}
+
+void TelemetryPanel::resized()
+{
+    auto bounds = getLocalBounds();
+    auto buttons = bounds.removeFromBottom(30);
+    copyButton.setBounds(buttons.removeFromLeft(buttons.getWidth() / 2).withTrimmedRight(5));
+    resetButton.setBounds(buttons.withTrimmedLeft(5));
+    statsText.setBounds(bounds.withTrimmedBottom(10));
+}
@@ -0,0 +1,32 @@
+/*
+  ==============================================================================
+
+    TelemetryPanel.h
+    Optional editor panel showing the processor's performance counters.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PerformanceCounters.h"
+
+class TelemetryPanel  : public juce::Component
+{
+public:
+    explicit TelemetryPanel(PerformanceCounters& counters);
+
+    // Re-reads the counters, called periodically by the editor while the panel is visible
+    void refresh();
+
+    void resized() override;
+
+private:
+    PerformanceCounters& counters;
+    juce::TextEditor statsText;
+    juce::TextButton copyButton;
+    juce::TextButton resetButton;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TelemetryPanel)
+};
@@ -0,0 +1,265 @@
+/*
+  ==============================================================================
+
+    LatchBench.cpp
+
+  ==============================================================================
+*/
+
+#include "LatchBench.h"
+#include "PluginProcessor.h"
+#include "RealtimeWatchdog.h"
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    // Plays the midi of one workload, the same for every build
+    struct Player
+    {
+        juce::Random random { 1 };
+        double sampleRate = 48000.0;
+        // Sample of the next step of the workload
+        juce::int64 nextStep = 0;
+        // Keys held down per channel
+        std::array<std::vector<int>, 16> held;
+
+        // Releases the keys held on channel and presses a chord of numNotes random keys
+        void playChord(juce::MidiBuffer& midi, int channel, int numNotes, int position)
+        {
+            auto& keys = held[(size_t) (channel - 1)];
+            for (int note : keys)
+            {
+                midi.addEvent(juce::MidiMessage::noteOff(channel, note), position);
+            }
+            keys.clear();
+            while (--numNotes >= 0)
+            {
+                const int note = 36 + random.nextInt(48);
+                keys.push_back(note);
+                midi.addEvent(juce::MidiMessage::noteOn(channel, note, (juce::uint8) (1 + random.nextInt(127))), position);
+            }
+        }
+
+        // Calls step with the position of every step due in the block, steps apart
+        template <typename Step>
+        void forEachStep(juce::int64 blockStart, int numSamples, double stepMs, Step&& step)
+        {
+            const auto stepSamples = juce::jmax((juce::int64) 1, (juce::int64) (stepMs * sampleRate / 1000.0));
+            for (; nextStep < blockStart + numSamples; nextStep += stepSamples)
+            {
+                step((int) (nextStep - blockStart));
+            }
+        }
+    };
+
+    struct Workload
+    {
+        const char* name;
+        // Sets the processor up before it is prepared
+        void (*setUp)(MidilatchAudioProcessor& processor, Player& player);
+        // Adds the input of the block starting at blockStart
+        void (*play)(Player& player, juce::MidiBuffer& midi, juce::int64 blockStart, int numSamples);
+    };
+
+    // Every program of the given banks (bank select MSB, LSB 0) maps to a chord of 3 to 10 notes
+    MidiMapping makeMapping(Player& player, int numBanks)
+    {
+        MidiMapping mapping;
+        for (int bank = 0; bank < numBanks; ++bank)
+        {
+            for (int program = 0; program < 128; ++program)
+            {
+                std::vector<int> notes;
+                for (int numNotes = 3 + player.random.nextInt(8); --numNotes >= 0;)
+                {
+                    notes.push_back(36 + player.random.nextInt(48));
+                }
+                mapping.assign(MidiMapping::makeKey(bank * 128, program), std::move(notes));
+            }
+        }
+        return mapping;
+    }
+
+    constexpr int denseChordChannels = 4;
+
+    const Workload workloads[] =
+    {
+        {
+            "dense chords",
+            [] (MidilatchAudioProcessor& processor, Player&)
+            {
+                processor.setLatchChannelsSeparately(true);
+                processor.setMinimalTransitions(true);
+                processor.setSharedNotePolicy(SharedNotePolicy::retriggerIfVelocityChanged);
+            },
+            [] (Player& player, juce::MidiBuffer& midi, juce::int64 blockStart, int numSamples)
+            {
+                player.forEachStep(blockStart, numSamples, 5.0, [&] (int position)
+                {
+                    player.playChord(midi, 1 + player.random.nextInt(denseChordChannels), 3 + player.random.nextInt(8), position);
+                });
+            }
+        },
+        {
+            "program changes",
+            [] (MidilatchAudioProcessor& processor, Player& player)
+            {
+                processor.publishMapping(makeMapping(player, 1), "Bench");
+                processor.setMinimalTransitions(true);
+                processor.setChordMatching(ChordMatching::exact);
+                processor.setSendMatchedProgramChanges(true);
+            },
+            [] (Player& player, juce::MidiBuffer& midi, juce::int64 blockStart, int numSamples)
+            {
+                player.forEachStep(blockStart, numSamples, 2.0, [&] (int position)
+                {
+                    midi.addEvent(juce::MidiMessage::programChange(1, player.random.nextInt(128)), position);
+                });
+            }
+        },
+        {
+            "large mapping",
+            [] (MidilatchAudioProcessor& processor, Player& player)
+            {
+                processor.publishMapping(makeMapping(player, 128), "Bench");
+                processor.setTransposeOffset(5);
+                processor.setChordMatching(ChordMatching::anyOctave);
+            },
+            [] (Player& player, juce::MidiBuffer& midi, juce::int64 blockStart, int numSamples)
+            {
+                player.forEachStep(blockStart, numSamples, 2.0, [&] (int position)
+                {
+                    midi.addEvent(juce::MidiMessage::controllerEvent(1, 0, player.random.nextInt(128)), position);
+                    midi.addEvent(juce::MidiMessage::controllerEvent(1, 32, 0), position);
+                    midi.addEvent(juce::MidiMessage::programChange(1, player.random.nextInt(128)), position);
+                });
+            }
+        },
+        {
+            "recording",
+            [] (MidilatchAudioProcessor& processor, Player&)
+            {
+                processor.setStoring(true);
+            },
+            [] (Player& player, juce::MidiBuffer& midi, juce::int64 blockStart, int numSamples)
+            {
+                // Every chord is stored under a program of its own while its keys are held
+                player.forEachStep(blockStart, numSamples, 20.0, [&] (int position)
+                {
+                    player.playChord(midi, 1, 3 + player.random.nextInt(6), position);
+                    midi.addEvent(juce::MidiMessage::programChange(1, player.random.nextInt(128)), position);
+                });
+            }
+        }
+    };
+
+    // Allocations recorded by the watchdog since its last reset
+    juce::int64 countAllocations()
+    {
+        std::array<RealtimeWatchdog::Violation, 64> violations;
+        const int numViolations = RealtimeWatchdog::getViolations(violations.data(), (int) violations.size());
+        juce::int64 allocations = 0;
+        for (int i = 0; i < numViolations; ++i)
+        {
+            allocations += violations[(size_t) i].type == RealtimeWatchdog::ViolationType::allocation ? violations[(size_t) i].count : 0;
+        }
+        return allocations;
+    }
+
+    const char* describe(RealtimeWatchdog::ViolationType type)
+    {
+        switch (type)
+        {
+            case RealtimeWatchdog::ViolationType::allocation: return "allocations";
+            case RealtimeWatchdog::ViolationType::deallocation: return "deallocations";
+            case RealtimeWatchdog::ViolationType::lock: return "locks";
+        }
+        return "";
+    }
+
+    // Runs one workload on a fresh processor, returns the number of watchdog violations
+    int runWorkload(const Workload& workload, const LatchBench::Options& options)
+    {
+        Player player;
+        player.sampleRate = options.sampleRate;
+        MidilatchAudioProcessor processor;
+        workload.setUp(processor, player);
+        processor.setRateAndBufferSizeDetails(options.sampleRate, options.blockSize);
+        processor.prepareToPlay(options.sampleRate, options.blockSize);
+
+        juce::AudioBuffer<float> audio(juce::jmax(1, processor.getTotalNumOutputChannels()), options.blockSize);
+        // Not reserved: like a host's buffer it only has room for the input, so any
+        // growth from the processor's output shows up as allocations. The processor
+        // grows it once to the worst case, which a host reusing its buffer sees on the
+        // first block only, so one empty block goes through before counting starts.
+        juce::MidiBuffer midi;
+        processor.processBlock(audio, midi);
+        // Nothing runs the processor's timer here, so stored chords are applied in its place
+        const int blocksPerTimerTick = juce::jmax(1, juce::roundToInt(options.sampleRate / 10.0 / options.blockSize));
+        processor.getPerformanceCounters().reset();
+        RealtimeWatchdog::reset();
+        juce::int64 mostAllocationsPerBlock = 0;
+        juce::int64 allocations = 0;
+        juce::int64 blockStart = 0;
+        for (int block = 0; block < options.blocksPerWorkload; ++block)
+        {
+            midi.clear();
+            workload.play(player, midi, blockStart, options.blockSize);
+            audio.clear();
+            processor.processBlock(audio, midi);
+            blockStart += options.blockSize;
+
+            const auto allocationsSoFar = countAllocations();
+            mostAllocationsPerBlock = juce::jmax(mostAllocationsPerBlock, allocationsSoFar - allocations);
+            allocations = allocationsSoFar;
+            if (block % blocksPerTimerTick == 0)
+            {
+                processor.getMidiMappingStore().collectGarbage();
+            }
+        }
+        processor.releaseResources();
+
+        const auto stats = processor.getPerformanceCounters().getSnapshot();
+        std::cout << juce::String(workload.name).paddedRight(' ', 16) << juce::String(stats.eventsIn).paddedLeft(' ', 9) << " events, "
+                  << juce::String(stats.getNsPerEvent(), 1).paddedLeft(' ', 8) << " ns/event, worst block "
+                  << juce::String(stats.worstBlockNs / 1000.0, 1).paddedLeft(' ', 7) << " us";
+        if (MIDILATCH_REALTIME_WATCHDOG)
+        {
+            std::cout << ", " << juce::String((double) allocations / (double) juce::jmax(1, options.blocksPerWorkload), 2)
+                      << " allocations/block (at most " << mostAllocationsPerBlock << ")";
+        }
+        std::cout << std::endl;
+
+        std::array<RealtimeWatchdog::Violation, 64> violations;
+        const int numViolations = RealtimeWatchdog::getViolations(violations.data(), (int) violations.size());
+        for (int i = 0; i < numViolations; ++i)
+        {
+            std::cout << "    " << violations[(size_t) i].count << " " << describe(violations[(size_t) i].type) << " in " << violations[(size_t) i].tag << std::endl;
+        }
+        return RealtimeWatchdog::getNumViolations();
+    }
+}
+
+//==============================================================================
+int LatchBench::run(const Options& options)
+{
+    std::cout << "bench: " << options.blocksPerWorkload << " blocks of " << options.blockSize << " samples at " << options.sampleRate
+              << " Hz per workload" << std::endl;
+    if (!MIDILATCH_REALTIME_WATCHDOG)
+    {
+        std::cout << "built without MIDILATCH_REALTIME_WATCHDOG, allocations are not counted" << std::endl;
+    }
+
+    int violations = 0;
+    for (const auto& workload : workloads)
+    {
+        violations += runWorkload(workload, options);
+    }
+    if (violations > 0)
+    {
+        std::cerr << violations << " allocations, deallocations or locks on the audio thread" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+  ==============================================================================
+
+    LatchBench.h
+    midilatch-render --bench: fixed synthetic workloads pushed through the
+    processor, timed and checked for heap use on the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Every workload sets up a fresh processor without an editor and drives processBlock
+// with the same seeded midi every time, so results are comparable between builds:
+//
+//   dense chords     chords of up to ten notes on four channels latched separately,
+//                    with minimal transitions and retriggering
+//   program changes  a program change every few milliseconds into a bank of mapped
+//                    chords, matched and sent on
+//   large mapping    random bank selects and program changes into all 16384 programs
+//                    of 128 banks, transposed
+//   recording        chords played and stored in Record mode
+//
+// Each prints ns per input event, the worst block time and the heap allocations per
+// block seen by RealtimeWatchdog, malloc and realloc included (midilatch-render builds
+// with MIDILATCH_REALTIME_WATCHDOG_MALLOC), so a midi buffer growing on the audio thread
+// counts. Stored chords are applied between blocks, as the plugin's timer would.
+namespace LatchBench
+{
+    struct Options
+    {
+        int blocksPerWorkload = 20000;
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+    };
+
+    // Prints one line per workload, returns 0 unless the watchdog saw the audio thread
+    // allocate or lock
+    int run(const Options& options);
+}
@@ -0,0 +1,746 @@
+/*
+  ==============================================================================
+
+    LatchFuzzer.cpp
+
+  ==============================================================================
+*/
+
+#include "LatchFuzzer.h"
+#include "PluginProcessor.h"
+#include "ReferenceLatch.h"
+#include "StateFormat.h"
+#include <atomic>
+#include <iostream>
+
+namespace
+{
+    using Message = ReferenceLatch::Message;
+
+    // Program 127 of bank 16383, which no run maps, so a program change to it releases
+    // a latch without starting anything
+    constexpr int releaseKey = MidiMapping::numKeys - 1;
+
+    struct Totals
+    {
+        int runs = 0;
+        int modelledRuns = 0;
+        juce::int64 eventsIn = 0;
+        juce::int64 eventsOut = 0;
+        juce::int64 blocks = 0;
+        juce::int64 samples = 0;
+        int stateLoads = 0;
+        // Spent in processBlock
+        juce::int64 processTicks = 0;
+
+        void add(const Totals& other)
+        {
+            runs += other.runs;
+            modelledRuns += other.modelledRuns;
+            eventsIn += other.eventsIn;
+            eventsOut += other.eventsOut;
+            blocks += other.blocks;
+            samples += other.samples;
+            stateLoads += other.stateLoads;
+            processTicks += other.processTicks;
+        }
+    };
+
+    juce::String describe(const std::vector<Message>& messages)
+    {
+        juce::String text;
+        for (const auto& message : messages)
+        {
+            text << "\n      " << juce::String(message.time) << ": " << juce::String::toHexString(message.bytes.data(), (int) message.bytes.size());
+        }
+        return text.isEmpty() ? juce::String("\n      (nothing)") : text;
+    }
+
+    //==============================================================================
+    int randomTransposeOffset(juce::Random& random)
+    {
+        if (random.nextBool()) { return 0; }
+        const int maxOffset = MidilatchAudioProcessor::maxTransposeOffset;
+        return random.nextInt(4) != 0 ? random.nextInt(49) - 24 : random.nextInt(2 * maxOffset + 1) - maxOffset;
+    }
+
+    int randomChordWindowMs(juce::Random& random)
+    {
+        if (random.nextBool()) { return 0; }
+        return random.nextInt(4) != 0 ? random.nextInt(200) : random.nextInt(MidilatchAudioProcessor::maxChordWindowMs + 1);
+    }
+
+    // Mostly a handful of bank 0 programs, so program changes often find a chord. Now
+    // and then a chord repeats a note or has none at all.
+    ReferenceLatch::Mapping makeMapping(juce::Random& random)
+    {
+        ReferenceLatch::Mapping mapping;
+        for (int entries = random.nextInt(24); --entries >= 0;)
+        {
+            const int bank = random.nextInt(4) != 0 ? 0 : 1 + random.nextInt(3);
+            const int program = random.nextInt(4) != 0 ? random.nextInt(16) : random.nextInt(127);
+            std::vector<int> notes;
+            for (int numNotes = random.nextInt(8); --numNotes >= 0;)
+            {
+                notes.push_back(random.nextInt(4) != 0 ? 36 + random.nextInt(48) : random.nextInt(128));
+            }
+            if (!notes.empty() && random.nextInt(8) == 0)
+            {
+                notes.push_back(notes.front());
+            }
+            mapping[MidiMapping::makeKey(bank, program)] = std::move(notes);
+        }
+        return mapping;
+    }
+
+    MidiMapping toMidiMapping(const ReferenceLatch::Mapping& mapping)
+    {
+        MidiMapping midiMapping;
+        for (const auto& [key, notes] : mapping)
+        {
+            midiMapping.assign(key, notes);
+        }
+        return midiMapping;
+    }
+
+    ReferenceLatch::Mapping readMapping(const MidiMapping& midiMapping)
+    {
+        ReferenceLatch::Mapping mapping;
+        midiMapping.forEach([&mapping](int key, const std::vector<int>& notes) { mapping[key] = notes; });
+        return mapping;
+    }
+
+    // Strumming, output pacing and sending matched program changes stay off in runs that
+    // are checked against the model
+    StateFormat::Settings makeSettings(juce::Random& random, bool modelled)
+    {
+        StateFormat::Settings settings;
+        settings.minimalTransitions = random.nextBool();
+        settings.sharedNotePolicy = random.nextInt(2);
+        settings.latchChannelsSeparately = random.nextInt(3) == 0;
+        settings.mappingChannel = random.nextBool() ? 1 : 1 + random.nextInt(16);
+        settings.transposeOffset = randomTransposeOffset(random);
+        settings.transposeBounds = random.nextInt(3);
+        settings.chordWindowMs = randomChordWindowMs(random);
+        settings.chordMatching = random.nextInt(3);
+        if (!modelled)
+        {
+            settings.sendMatchedProgramChanges = random.nextBool();
+            settings.outputBytesPerSecond = random.nextBool() ? 0 : random.nextBool() ? OutputScheduler::dinMidiBytesPerSecond : 1000 + random.nextInt(20000);
+            settings.strumDirection = random.nextInt(2);
+            settings.strumSpreadMs = random.nextBool() ? 0 : random.nextInt(200);
+            settings.firstChordVelocity = 1 + random.nextInt(127);
+            settings.lastChordVelocity = 1 + random.nextInt(127);
+        }
+        return settings;
+    }
+
+    // The settings the processor holds, as a state would save them
+    StateFormat::Settings readSettings(MidilatchAudioProcessor& processor)
+    {
+        const auto& strummer = processor.getStrumScheduler();
+        StateFormat::Settings settings;
+        settings.minimalTransitions = processor.getMinimalTransitions();
+        settings.sharedNotePolicy = (int) processor.getSharedNotePolicy();
+        settings.latchChannelsSeparately = processor.getLatchChannelsSeparately();
+        settings.mappingChannel = processor.getMappingChannel();
+        settings.transposeOffset = processor.getTransposeOffset();
+        settings.transposeBounds = (int) processor.getTransposeBounds();
+        settings.chordWindowMs = processor.getChordWindowMs();
+        settings.chordMatching = (int) processor.getChordMatching();
+        settings.sendMatchedProgramChanges = processor.getSendMatchedProgramChanges();
+        settings.outputBytesPerSecond = processor.getOutputScheduler().getBytesPerSecond();
+        settings.strumDirection = (int) strummer.getDirection();
+        settings.strumSpreadMs = strummer.getSpreadMs();
+        settings.firstChordVelocity = strummer.getFirstVelocity();
+        settings.lastChordVelocity = strummer.getLastVelocity();
+        return settings;
+    }
+
+    // The first setting that differs, empty if none does
+    juce::String findDifferentSetting(const StateFormat::Settings& a, const StateFormat::Settings& b)
+    {
+        const std::pair<const char*, bool> settings[] = {
+            { "minimal transitions", a.minimalTransitions == b.minimalTransitions },
+            { "shared note policy", a.sharedNotePolicy == b.sharedNotePolicy },
+            { "latch channels separately", a.latchChannelsSeparately == b.latchChannelsSeparately },
+            { "mapping channel", a.mappingChannel == b.mappingChannel },
+            { "transpose offset", a.transposeOffset == b.transposeOffset },
+            { "transpose bounds", a.transposeBounds == b.transposeBounds },
+            { "chord window", a.chordWindowMs == b.chordWindowMs },
+            { "chord matching", a.chordMatching == b.chordMatching && a.sendMatchedProgramChanges == b.sendMatchedProgramChanges },
+            { "output pacing", a.outputBytesPerSecond == b.outputBytesPerSecond },
+            { "strum", a.strumDirection == b.strumDirection && a.strumSpreadMs == b.strumSpreadMs },
+            { "chord velocity", a.firstChordVelocity == b.firstChordVelocity && a.lastChordVelocity == b.lastChordVelocity },
+        };
+        for (const auto& [name, isSame] : settings)
+        {
+            if (!isSame) { return name; }
+        }
+        return {};
+    }
+
+    ReferenceLatch::Settings toModelSettings(const StateFormat::Settings& settings, bool recording, double sampleRate)
+    {
+        ReferenceLatch::Settings modelSettings;
+        modelSettings.recording = recording;
+        modelSettings.minimalTransitions = settings.minimalTransitions;
+        modelSettings.sharedNotePolicy = settings.sharedNotePolicy == (int) SharedNotePolicy::retriggerIfVelocityChanged
+                                             ? SharedNotePolicy::retriggerIfVelocityChanged : SharedNotePolicy::keepSounding;
+        modelSettings.latchChannelsSeparately = settings.latchChannelsSeparately;
+        modelSettings.mappingChannelIndex = LatchedNotes::toChannelIndex(settings.mappingChannel);
+        modelSettings.transposeOffset = settings.transposeOffset;
+        modelSettings.transposeBounds = (TransposeBounds) settings.transposeBounds;
+        modelSettings.captureWindow = (std::int64_t) (settings.chordWindowMs * sampleRate / 1000.0);
+        return modelSettings;
+    }
+
+    // Whether the processor only does what ReferenceLatch models
+    bool isModelled(const StateFormat::Settings& settings)
+    {
+        return settings.strumSpreadMs == 0 && settings.firstChordVelocity == 127 && settings.lastChordVelocity == 127
+            && settings.outputBytesPerSecond == 0 && !(settings.sendMatchedProgramChanges && settings.chordMatching != (int) ChordMatching::off);
+    }
+
+    //==============================================================================
+    void writeLittleEndianInt(juce::uint8* bytes, juce::uint32 value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            bytes[i] = (juce::uint8) (value >> (8 * i));
+        }
+    }
+
+    // Makes the header's payload size and checksum fit whatever the payload is now, so
+    // the reader gets past them to the damaged payload
+    void fixHeader(juce::MemoryBlock& state)
+    {
+        if (state.getSize() < (size_t) StateFormat::headerSize) { return; }
+        auto* bytes = static_cast<juce::uint8*>(state.getData());
+        juce::uint32 checksum = 2166136261u;
+        for (size_t i = StateFormat::headerSize; i < state.getSize(); ++i)
+        {
+            checksum = (checksum ^ bytes[i]) * 16777619u;
+        }
+        writeLittleEndianInt(bytes + 8, (juce::uint32) (state.getSize() - StateFormat::headerSize));
+        writeLittleEndianInt(bytes + 12, checksum);
+    }
+
+    void mutate(juce::MemoryBlock& state, juce::Random& random)
+    {
+        for (int edits = 1 + random.nextInt(4); --edits >= 0;)
+        {
+            const int size = (int) state.getSize();
+            switch (random.nextInt(3))
+            {
+                case 0:
+                    if (size > 0) { state[random.nextInt(size)] ^= (char) (1 << random.nextInt(8)); }
+                    break;
+                case 1:
+                    state.setSize((size_t) random.nextInt(size + 1));
+                    break;
+                default:
+                {
+                    const juce::uint8 bytes[] = { (juce::uint8) random.nextInt(256), 0x00, 0xff, 0x80 };
+                    state.insert(bytes, (size_t) (1 + random.nextInt((int) sizeof(bytes))), (size_t) random.nextInt(size + 1));
+                    break;
+                }
+            }
+        }
+        if (random.nextBool()) { fixHeader(state); }
+    }
+
+    // Random bytes, half of the time behind a header the reader accepts
+    void makeRandomState(juce::MemoryBlock& state, juce::Random& random)
+    {
+        state.setSize((size_t) random.nextInt(96));
+        random.fillBitsRandomly(state.getData(), state.getSize());
+        if (state.getSize() >= (size_t) StateFormat::headerSize && random.nextBool())
+        {
+            auto* bytes = static_cast<juce::uint8*>(state.getData());
+            const int version = 1 + random.nextInt(StateFormat::currentVersion);
+            const juce::uint8 header[] = { 'M', 'L', 'C', 'H', (juce::uint8) version, 0, (juce::uint8) StateFormat::headerSize, 0 };
+            std::copy(std::begin(header), std::end(header), bytes);
+            fixHeader(state);
+        }
+    }
+
+    //==============================================================================
+    // Random midi with enough structure to matter: most notes on a few channels and in
+    // two octaves, so chords overlap, note offs mostly for held keys, program changes
+    // mostly for mapped programs, and gaps from none at all (several messages at one
+    // sample) to longer than any capture window, some right at its edge.
+    class InputGenerator
+    {
+    public:
+        explicit InputGenerator(juce::Random& randomToUse) : random(randomToUse) {}
+
+        void setMapping(const ReferenceLatch::Mapping& mapping)
+        {
+            mappedKeys.clear();
+            for (const auto& entry : mapping) { mappedKeys.push_back(entry.first); }
+        }
+        void setCaptureWindow(juce::int64 samples) { captureWindow = samples; }
+
+        // The next message, time stamped in samples since the start of the run
+        juce::MidiMessage next()
+        {
+            auto message = makeMessage();
+            message.setTimeStamp((double) time);
+            time += makeGap();
+            return message;
+        }
+
+    private:
+        int pickChannel()
+        {
+            const int choice = random.nextInt(10);
+            return choice < 6 ? 1 : choice < 8 ? 2 + random.nextInt(2) : choice < 9 ? 16 : 1 + random.nextInt(16);
+        }
+        int pickNote() { return random.nextInt(4) != 0 ? 48 + random.nextInt(25) : random.nextInt(128); }
+        int pickKey()
+        {
+            if (!mappedKeys.empty() && random.nextInt(4) != 0)
+            {
+                return mappedKeys[(size_t) random.nextInt((int) mappedKeys.size())];
+            }
+            return random.nextInt(MidiMapping::makeKey(4, 0));
+        }
+
+        juce::MidiMessage makeMessage()
+        {
+            const int channel = pickChannel();
+            const int kind = random.nextInt(100);
+            if (kind < 35)
+            {
+                const int note = pickNote();
+                held.push_back({ channel, note });
+                if (held.size() > 32) { held.erase(held.begin()); }
+                return juce::MidiMessage::noteOn(channel, note, (juce::uint8) (random.nextInt(4) != 0 ? 1 + random.nextInt(127) : 127));
+            }
+            if (kind < 60)
+            {
+                auto key = std::make_pair(channel, pickNote());
+                if (!held.empty() && random.nextInt(5) != 0)
+                {
+                    const int index = random.nextInt((int) held.size());
+                    key = held[(size_t) index];
+                    held.erase(held.begin() + index);
+                }
+                // Some keyboards send note ons with velocity 0 instead
+                return random.nextInt(4) == 0 ? juce::MidiMessage::noteOn(key.first, key.second, (juce::uint8) 0)
+                                              : juce::MidiMessage::noteOff(key.first, key.second);
+            }
+            if (kind < 72)
+            {
+                return juce::MidiMessage::programChange(channel, MidiMapping::getProgram(pickKey()));
+            }
+            if (kind < 77)
+            {
+                const int bank = MidiMapping::getBank(pickKey());
+                return random.nextBool() ? juce::MidiMessage::controllerEvent(channel, 0, bank >> 7)
+                                         : juce::MidiMessage::controllerEvent(channel, 32, bank & 127);
+            }
+            if (kind < 80) { return juce::MidiMessage::allNotesOff(channel); }
+            if (kind < 90) { return juce::MidiMessage::controllerEvent(channel, random.nextInt(120), random.nextInt(128)); }
+            if (kind < 95) { return juce::MidiMessage::pitchWheel(channel, random.nextInt(16384)); }
+            if (kind < 97) { return juce::MidiMessage::channelPressureChange(channel, random.nextInt(128)); }
+            if (kind < 98) { return juce::MidiMessage::midiClock(); }
+            const juce::uint8 sysex[] = { 0x7d, (juce::uint8) random.nextInt(128), (juce::uint8) random.nextInt(128) };
+            return juce::MidiMessage::createSysExMessage(sysex, (int) sizeof(sysex));
+        }
+
+        juce::int64 makeGap()
+        {
+            const int kind = random.nextInt(100);
+            if (kind < 40) { return 0; }
+            if (kind < 80) { return random.nextInt(200); }
+            if (kind < 88 && captureWindow > 0) { return captureWindow - 1 + random.nextInt(3); }
+            if (kind < 97) { return random.nextInt(5000); }
+            return random.nextInt(48000);
+        }
+
+        juce::Random& random;
+        std::vector<int> mappedKeys;
+        // Keys pressed and not released yet, as (channel, note)
+        std::vector<std::pair<int, int>> held;
+        juce::int64 captureWindow = 0;
+        juce::int64 time = 0;
+    };
+
+    //==============================================================================
+    class FuzzRun
+    {
+    public:
+        FuzzRun(juce::int64 seed, const LatchFuzzer::Options& runOptions)
+            : random(seed), options(runOptions), input(random)
+        {
+        }
+
+        // Returns why the run failed, empty if it passed
+        juce::String run()
+        {
+            modelled = random.nextInt(4) != 0;
+            totals.runs = 1;
+            auto failure = loadSavedState();
+            processor.setRateAndBufferSizeDetails(options.sampleRate, options.maxBlockSize);
+            processor.prepareToPlay(options.sampleRate, options.maxBlockSize);
+            audio.setSize(juce::jmax(1, processor.getTotalNumOutputChannels()), options.maxBlockSize);
+
+            juce::MidiBuffer midi;
+            auto message = input.next();
+            for (int eventsLeft = options.eventsPerRun; eventsLeft > 0 && failure.isEmpty();)
+            {
+                // Between blocks, as a host would
+                const int action = random.nextInt(200);
+                if (action < 5) { changeSetting(); }
+                else if (action == 5) { failure = loadSavedState(); }
+                else if (action == 6) { failure = loadOwnState(); }
+                else if (action == 7) { loadBrokenState(); }
+                if (failure.isNotEmpty()) { break; }
+
+                const int numSamples = pickBlockSize();
+                midi.clear();
+                while (eventsLeft > 0 && (juce::int64) message.getTimeStamp() < blockStart + numSamples)
+                {
+                    midi.addEvent(message, (int) ((juce::int64) message.getTimeStamp() - blockStart));
+                    message = input.next();
+                    --eventsLeft;
+                }
+                failure = processBlock(midi, numSamples);
+            }
+            if (failure.isEmpty())
+            {
+                failure = releaseEverything();
+            }
+            processor.releaseResources();
+            totals.modelledRuns = modelled ? 1 : 0;
+            return failure;
+        }
+
+        const Totals& getTotals() const { return totals; }
+
+    private:
+        // Mostly powers of two as hosts use, sometimes anything up to the maximum
+        int pickBlockSize()
+        {
+            if (random.nextBool()) { return juce::jmin(options.maxBlockSize, 1 << random.nextInt(11)); }
+            return 1 + random.nextInt(options.maxBlockSize);
+        }
+
+        // After the processor's mapping or settings changed
+        void syncModel()
+        {
+            const auto settings = readSettings(processor);
+            modelled = modelled && isModelled(settings);
+            model.setMapping(mapping);
+            model.setSettings(toModelSettings(settings, processor.getStoring(), options.sampleRate));
+            input.setMapping(mapping);
+            input.setCaptureWindow(model.getSettings().captureWindow);
+        }
+
+        void changeSetting()
+        {
+            switch (random.nextInt(modelled ? 8 : 11))
+            {
+                case 0: processor.setStoring(!processor.getStoring()); break;
+                case 1: processor.setMinimalTransitions(!processor.getMinimalTransitions()); break;
+                case 2: processor.setSharedNotePolicy(processor.getSharedNotePolicy() == SharedNotePolicy::keepSounding
+                                                          ? SharedNotePolicy::retriggerIfVelocityChanged : SharedNotePolicy::keepSounding); break;
+                case 3: processor.setLatchChannelsSeparately(!processor.getLatchChannelsSeparately()); break;
+                case 4: processor.setMappingChannel(1 + random.nextInt(16)); break;
+                case 5: processor.setTransposeOffset(randomTransposeOffset(random)); break;
+                case 6: processor.setTransposeBounds((TransposeBounds) random.nextInt(3)); break;
+                case 7: processor.setChordWindowMs(randomChordWindowMs(random)); break;
+                case 8: processor.getStrumScheduler().setSpreadMs(random.nextBool() ? 0 : random.nextInt(200)); break;
+                case 9: processor.getOutputScheduler().setBytesPerSecond(random.nextBool() ? 0 : OutputScheduler::dinMidiBytesPerSecond); break;
+                default: processor.setSendMatchedProgramChanges(!processor.getSendMatchedProgramChanges()); break;
+            }
+            syncModel();
+        }
+
+        // A state as the plugin saves it, which has to load exactly as written
+        juce::String loadSavedState()
+        {
+            const auto savedMapping = makeMapping(random);
+            const auto settings = makeSettings(random, modelled);
+            juce::MemoryBlock state;
+            StateFormat::write(toMidiMapping(savedMapping), settings, state);
+            processor.setStateInformation(state.getData(), (int) state.getSize());
+            ++totals.stateLoads;
+            if (readMapping(processor.getMidiMappingStore().get()) != savedMapping)
+            {
+                return "a saved mapping did not load as written";
+            }
+            const auto setting = findDifferentSetting(readSettings(processor), settings);
+            if (setting.isNotEmpty())
+            {
+                return "the " + setting + " setting did not load as written";
+            }
+            if (processor.getStoring())
+            {
+                return "a saved state loaded with record mode on";
+            }
+            mapping = savedMapping;
+            syncModel();
+            return {};
+        }
+
+        // The processor's own state, which must not change anything
+        juce::String loadOwnState()
+        {
+            const auto settings = readSettings(processor);
+            juce::MemoryBlock state;
+            processor.getStateInformation(state);
+            processor.setStateInformation(state.getData(), (int) state.getSize());
+            ++totals.stateLoads;
+            if (readMapping(processor.getMidiMappingStore().get()) != mapping)
+            {
+                return "reloading the processor's own state changed the mapping";
+            }
+            const auto setting = findDifferentSetting(readSettings(processor), settings);
+            if (setting.isNotEmpty())
+            {
+                return "reloading the processor's own state changed the " + setting + " setting";
+            }
+            // Published again all the same, so mapped chords are released note by note
+            syncModel();
+            return {};
+        }
+
+        // A damaged or random blob, which may be rejected or loaded but must leave the
+        // processor playable. If it loaded, the model takes over what the processor made
+        // of it.
+        void loadBrokenState()
+        {
+            juce::MemoryBlock state;
+            if (random.nextBool())
+            {
+                StateFormat::write(toMidiMapping(makeMapping(random)), makeSettings(random, modelled), state);
+                mutate(state, random);
+            }
+            else
+            {
+                makeRandomState(state, random);
+            }
+            const auto version = processor.getMidiMappingStore().getVersion();
+            processor.setStateInformation(state.getData(), (int) state.getSize());
+            ++totals.stateLoads;
+            if (processor.getMidiMappingStore().getVersion() != version)
+            {
+                mapping = readMapping(processor.getMidiMappingStore().get());
+                syncModel();
+            }
+        }
+
+        // Why a message cannot go out as it is, empty if it can
+        static juce::String checkMessage(const juce::MidiMessageMetadata& metadata, int numSamples)
+        {
+            if (metadata.samplePosition < 0 || metadata.samplePosition >= numSamples) { return "message outside of its block"; }
+            const auto* data = metadata.data;
+            if (metadata.numBytes < 1 || data[0] < 0x80) { return "message without a status byte"; }
+            if (data[0] >= 0xf0) { return {}; }
+            const int size = (data[0] & 0xe0) == 0xc0 ? 2 : 3;
+            if (metadata.numBytes != size) { return "message of the wrong length"; }
+            for (int i = 1; i < size; ++i)
+            {
+                if (data[i] > 127) { return "data byte out of range"; }
+            }
+            return {};
+        }
+
+        // What a synth on the output has sounding
+        void updateSounding(const juce::uint8* data)
+        {
+            const int type = data[0] & 0xf0;
+            auto& channel = sounding[(size_t) (data[0] & 0x0f)];
+            if (type == 0x90 && data[2] != 0) { channel[data[1]] = true; }
+            else if (type == 0x80 || type == 0x90) { channel[data[1]] = false; }
+            else if (type == 0xb0 && (data[1] == 120 || data[1] == 123)) { channel.fill(false); }
+        }
+
+        juce::String processBlock(juce::MidiBuffer& midi, int numSamples)
+        {
+            const juce::MidiBuffer in(midi);
+            expected.clear();
+            if (modelled)
+            {
+                for (const auto metadata : midi)
+                {
+                    model.process(blockStart + metadata.samplePosition, metadata.data, metadata.numBytes, expected);
+                }
+            }
+
+            audio.setSize(audio.getNumChannels(), numSamples, false, false, true);
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+            processor.processBlock(audio, midi);
+            totals.processTicks += juce::Time::getHighResolutionTicks() - startTicks;
+            totals.eventsIn += in.getNumEvents();
+            totals.eventsOut += midi.getNumEvents();
+            totals.samples += numSamples;
+            ++totals.blocks;
+
+            const auto where = "block " + juce::String(totals.blocks) + " (samples " + juce::String(blockStart) + "-" + juce::String(blockStart + numSamples - 1) + ")";
+            actual.clear();
+            for (const auto metadata : midi)
+            {
+                const auto problem = checkMessage(metadata, numSamples);
+                if (problem.isNotEmpty())
+                {
+                    return where + ": " + problem + ": " + juce::String::toHexString(metadata.data, metadata.numBytes);
+                }
+                actual.push_back({ blockStart + metadata.samplePosition, { metadata.data, metadata.data + metadata.numBytes } });
+                if (metadata.data[0] < 0xf0)
+                {
+                    updateSounding(metadata.data);
+                }
+            }
+            if (modelled && !ReferenceLatch::sameNoteOrder(expected, actual))
+            {
+                std::vector<Message> inputMessages;
+                for (const auto metadata : in)
+                {
+                    inputMessages.push_back({ blockStart + metadata.samplePosition, { metadata.data, metadata.data + metadata.numBytes } });
+                }
+                return where + ": output differs from the reference model\n    in:" + describe(inputMessages)
+                       + "\n    expected:" + describe(expected) + "\n    got:" + describe(actual);
+            }
+            blockStart += numSamples;
+            return {};
+        }
+
+        // Releases every latch with a program change to nothing and lets strummed and paced
+        // notes go out. Nothing may be latched or sounding after that.
+        juce::String releaseEverything()
+        {
+            processor.setStoring(false);
+            syncModel();
+            juce::MidiBuffer midi;
+            const int bank = MidiMapping::getBank(releaseKey);
+            for (int channel = 1; channel <= 16; ++channel)
+            {
+                midi.addEvent(juce::MidiMessage::controllerEvent(channel, 0, bank >> 7), 0);
+                midi.addEvent(juce::MidiMessage::controllerEvent(channel, 32, bank & 127), 0);
+                midi.addEvent(juce::MidiMessage::programChange(channel, MidiMapping::getProgram(releaseKey)), 0);
+            }
+            auto failure = processBlock(midi, options.maxBlockSize);
+            const auto maxDrainSamples = (juce::int64) (60.0 * options.sampleRate);
+            for (juce::int64 drained = 0; failure.isEmpty() && (processor.getStrumScheduler().hasPendingNotes() || processor.getOutputScheduler().getQueueDepth() > 0);
+                 drained += options.maxBlockSize)
+            {
+                if (drained > maxDrainSamples)
+                {
+                    return "strummed or paced notes still waiting a minute after the last chord";
+                }
+                midi.clear();
+                failure = processBlock(midi, options.maxBlockSize);
+            }
+            if (failure.isNotEmpty()) { return failure; }
+
+            juce::String stuck;
+            for (int channel = 0; channel < 16; ++channel)
+            {
+                for (int note = 0; note < 128; ++note)
+                {
+                    if (sounding[(size_t) channel][(size_t) note])
+                    {
+                        stuck << " " << juce::MidiMessage::getMidiNoteName(note, true, true, 4) << " (channel " << (channel + 1) << ")";
+                    }
+                }
+            }
+            if (stuck.isNotEmpty())
+            {
+                return "notes still sounding after every latch was released:" + stuck;
+            }
+            const auto latched = processor.getLatchedPitchMask();
+            if ((latched[0] | latched[1]) != 0)
+            {
+                return "notes still latched after every latch was released";
+            }
+            return {};
+        }
+
+        juce::Random random;
+        const LatchFuzzer::Options& options;
+        InputGenerator input;
+        MidilatchAudioProcessor processor;
+        ReferenceLatch model;
+        // What the processor's mapping is meant to be
+        ReferenceLatch::Mapping mapping;
+        // Whether the output is checked against the model. Once a run strums or paces,
+        // it stays unmodelled, notes may still be waiting.
+        bool modelled = true;
+        juce::AudioBuffer<float> audio;
+        juce::int64 blockStart = 0;
+        std::array<std::array<bool, 128>, 16> sounding {};
+        std::vector<Message> expected, actual;
+        Totals totals;
+
+        JUCE_DECLARE_NON_COPYABLE (FuzzRun)
+    };
+}
+
+//==============================================================================
+int LatchFuzzer::run(const Options& options)
+{
+    std::cout << "fuzz: seed " << options.seed << ", " << options.runs << " runs of " << options.eventsPerRun << " events, blocks of up to "
+              << options.maxBlockSize << " samples at " << options.sampleRate << " Hz" << std::endl;
+
+    // Runs are independent, every job takes the next one until all are done or one failed
+    Totals totals;
+    juce::String failure;
+    juce::int64 failedSeed = 0;
+    juce::CriticalSection resultLock;
+    std::atomic<int> nextRun { 0 };
+    std::atomic<bool> failed { false };
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    {
+        juce::ThreadPool pool(options.numJobs);
+        for (int job = 0; job < options.numJobs; ++job)
+        {
+            pool.addJob([&]
+            {
+                for (int runIndex = nextRun++; runIndex < options.runs && !failed; runIndex = nextRun++)
+                {
+                    const auto seed = options.seed + runIndex;
+                    auto fuzzRun = std::make_unique<FuzzRun>(seed, options);
+                    const auto runFailure = fuzzRun->run();
+                    const juce::ScopedLock lock(resultLock);
+                    totals.add(fuzzRun->getTotals());
+                    if (runFailure.isNotEmpty() && !failed)
+                    {
+                        failed = true;
+                        failure = runFailure;
+                        failedSeed = seed;
+                    }
+                }
+            });
+        }
+        while (pool.getNumJobs() > 0)
+        {
+            juce::Thread::sleep(10);
+        }
+    }
+    const double wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+    const double processSeconds = juce::Time::highResolutionTicksToSeconds(totals.processTicks);
+    const double audioSeconds = (double) totals.samples / options.sampleRate;
+    std::cout << totals.runs << " runs (" << totals.modelledRuns << " against the reference model), " << totals.eventsIn << " events in, "
+              << totals.eventsOut << " out, " << totals.blocks << " blocks, " << totals.stateLoads << " states loaded, "
+              << juce::String(wallSeconds, 2) << " s on " << options.numJobs << " threads" << std::endl;
+    if (processSeconds > 0.0)
+    {
+        std::cout << "processBlock: " << juce::String(audioSeconds, 1) << " s of audio in " << juce::String(processSeconds * 1000.0, 1) << " ms ("
+                  << juce::String(audioSeconds / processSeconds, 0) << "x realtime, " << juce::String(totals.eventsIn / processSeconds / 1.0e6, 2)
+                  << " M events/s)" << std::endl;
+    }
+    if (failed)
+    {
+        std::cerr << "run with seed " << failedSeed << " failed: " << failure << "\n"
+                  << "replay it with: midilatch-render --fuzz --seed " << failedSeed << " --runs 1 --events " << options.eventsPerRun
+                  << " --block-size " << options.maxBlockSize << " --sample-rate " << options.sampleRate << std::endl;
+        return 1;
+    }
+    std::cout << "all runs passed" << std::endl;
+    return 0;
+}
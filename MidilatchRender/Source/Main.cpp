@@ -0,0 +1,412 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    midilatch-render: pushes Standard MIDI Files through the plugin's latch and
+    mapping logic offline, block by block, as a host would at the given sample
+    rate and block size.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "ChordLibrary.h"
+#include "LatchBench.h"
+#include "LatchFuzzer.h"
+#include "PluginProcessor.h"
+#include "StateFormat.h"
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    struct RenderOptions
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        juce::MemoryBlock state;
+        bool minimalTransitions = false;
+        bool paceToDinMidi = false;
+        bool printStats = false;
+        juce::File outputDirectory;
+    };
+
+    struct RenderResult
+    {
+        juce::File input;
+        juce::File output;
+        juce::String error;
+        juce::int64 blocks = 0;
+        int eventsIn = 0;
+        int eventsOut = 0;
+        double renderedSeconds = 0.0;
+        double wallSeconds = 0.0;
+        juce::String stats;
+    };
+
+    // The output is written at a fixed tempo, so one tick is a fixed amount of time
+    constexpr int outputTicksPerQuarterNote = 960;
+    constexpr int outputMicrosecondsPerQuarterNote = 500000;
+    constexpr double outputTicksPerSecond = outputTicksPerQuarterNote * 1.0e6 / outputMicrosecondsPerQuarterNote;
+
+    // All tracks merged into one stream timed in seconds, as the plugin would see them
+    // coming from a single midi input. Meta events never reach a plugin.
+    juce::Result readMidiFile(const juce::File& file, juce::MidiMessageSequence& sequence)
+    {
+        juce::FileInputStream stream(file);
+        juce::MidiFile midiFile;
+        if (!stream.openedOk() || !midiFile.readFrom(stream))
+        {
+            return juce::Result::fail("could not read " + file.getFullPathName());
+        }
+        midiFile.convertTimestampTicksToSeconds();
+        for (int track = 0; track < midiFile.getNumTracks(); ++track)
+        {
+            for (const auto* event : *midiFile.getTrack(track))
+            {
+                if (!event->message.isMetaEvent())
+                {
+                    sequence.addEvent(event->message);
+                }
+            }
+        }
+        return juce::Result::ok();
+    }
+
+    RenderResult renderFile(const juce::File& input, const RenderOptions& options)
+    {
+        RenderResult result;
+        result.input = input;
+        result.output = options.outputDirectory.getChildFile(input.getFileNameWithoutExtension() + "-latched.mid");
+
+        juce::MidiMessageSequence sequence;
+        const auto readResult = readMidiFile(input, sequence);
+        if (readResult.failed())
+        {
+            result.error = readResult.getErrorMessage();
+            return result;
+        }
+
+        MidilatchAudioProcessor processor;
+        if (options.state.getSize() > 0)
+        {
+            processor.setStateInformation(options.state.getData(), (int) options.state.getSize());
+        }
+        if (options.minimalTransitions)
+        {
+            processor.setMinimalTransitions(true);
+        }
+        if (options.paceToDinMidi)
+        {
+            processor.getOutputScheduler().setBytesPerSecond(OutputScheduler::dinMidiBytesPerSecond);
+        }
+        processor.setRateAndBufferSizeDetails(options.sampleRate, options.blockSize);
+        processor.prepareToPlay(options.sampleRate, options.blockSize);
+
+        juce::AudioBuffer<float> audio(juce::jmax(1, processor.getTotalNumOutputChannels()), options.blockSize);
+        juce::MidiBuffer midi;
+        juce::MidiMessageSequence rendered;
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+
+        int nextEvent = 0;
+        juce::int64 blockStart = 0;
+        // Keep going after the last input event until the paced output has drained
+        while (nextEvent < sequence.getNumEvents() || processor.getOutputScheduler().getQueueDepth() > 0)
+        {
+            const juce::int64 blockEnd = blockStart + options.blockSize;
+            midi.clear();
+            for (; nextEvent < sequence.getNumEvents(); ++nextEvent)
+            {
+                const auto& message = sequence.getEventPointer(nextEvent)->message;
+                const auto position = (juce::int64) (message.getTimeStamp() * options.sampleRate);
+                if (position >= blockEnd)
+                {
+                    break;
+                }
+                midi.addEvent(message, (int) (position - blockStart));
+                ++result.eventsIn;
+            }
+
+            audio.clear();
+            processor.processBlock(audio, midi);
+
+            for (const auto metadata : midi)
+            {
+                auto message = metadata.getMessage();
+                message.setTimeStamp((double) (blockStart + metadata.samplePosition) / options.sampleRate * outputTicksPerSecond);
+                rendered.addEvent(message);
+                ++result.eventsOut;
+            }
+            blockStart = blockEnd;
+            ++result.blocks;
+        }
+
+        result.wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        result.renderedSeconds = (double) blockStart / options.sampleRate;
+        processor.releaseResources();
+        if (options.printStats)
+        {
+            result.stats = processor.getPerformanceCounters().getSnapshot().toText();
+        }
+
+        rendered.addEvent(juce::MidiMessage::tempoMetaEvent(outputMicrosecondsPerQuarterNote), 0.0);
+        rendered.updateMatchedPairs();
+        juce::MidiFile midiFile;
+        midiFile.setTicksPerQuarterNote(outputTicksPerQuarterNote);
+        midiFile.addTrack(rendered);
+
+        result.output.deleteFile();
+        juce::FileOutputStream stream(result.output);
+        if (!stream.openedOk() || !midiFile.writeTo(stream))
+        {
+            result.error = "could not write " + result.output.getFullPathName();
+        }
+        return result;
+    }
+
+    // Either a state saved by the plugin or a mapping exported as text
+    juce::Result loadState(const juce::File& file, juce::MemoryBlock& state)
+    {
+        if (!file.loadFileAsData(state))
+        {
+            return juce::Result::fail("could not read " + file.getFullPathName());
+        }
+        MidiMapping mapping;
+        if (StateFormat::isBinary(state.getData(), state.getSize()))
+        {
+            StateFormat::Settings settings;
+            return StateFormat::read(state.getData(), state.getSize(), mapping, settings);
+        }
+        return mapping.parseStringSerialization(state.toString().toStdString());
+    }
+
+    // Everything that is neither an option nor the value of one is an input file
+    juce::Array<juce::File> getInputFiles(const juce::ArgumentList& args)
+    {
+        const juce::StringArray optionsWithValue { "--sample-rate", "--block-size", "--state", "--output-dir", "--jobs", "--make-library",
+                                                   "--seed", "--runs", "--events", "--blocks" };
+        juce::Array<juce::File> inputs;
+        for (int i = 0; i < args.size(); ++i)
+        {
+            if (args[i].isOption())
+            {
+                i += optionsWithValue.contains(args[i].text) ? 1 : 0;
+                continue;
+            }
+            inputs.add(args[i].resolveAsFile());
+        }
+        return inputs;
+    }
+
+    // Every input is an exported text mapping, and becomes the song named like the file
+    int makeLibrary(const juce::File& libraryFile, const juce::Array<juce::File>& inputs)
+    {
+        std::vector<std::pair<juce::String, MidiMapping>> songs;
+        for (const auto& input : inputs)
+        {
+            MidiMapping mapping;
+            const auto result = mapping.parseStringSerialization(input.loadFileAsString().toStdString());
+            if (result.failed())
+            {
+                juce::ConsoleApplication::fail(input.getFileName() + ": " + result.getErrorMessage());
+            }
+            songs.emplace_back(input.getFileNameWithoutExtension(), std::move(mapping));
+        }
+        const auto result = ChordLibrary::write(libraryFile, std::move(songs));
+        if (result.failed())
+        {
+            juce::ConsoleApplication::fail(libraryFile.getFileName() + ": " + result.getErrorMessage());
+        }
+        std::cout << libraryFile.getFileName() << ": " << inputs.size() << " songs" << std::endl;
+        return 0;
+    }
+
+    void printResult(const RenderResult& result)
+    {
+        if (result.error.isNotEmpty())
+        {
+            std::cerr << result.input.getFileName() << ": " << result.error << std::endl;
+            return;
+        }
+        const double realtimeFactor = result.wallSeconds > 0.0 ? result.renderedSeconds / result.wallSeconds : 0.0;
+        std::cout << result.input.getFileName() << " -> " << result.output.getFileName()
+                  << ": " << result.eventsIn << " events in, " << result.eventsOut << " out, "
+                  << result.blocks << " blocks, " << juce::String(result.renderedSeconds, 1) << " s rendered in "
+                  << juce::String(result.wallSeconds * 1000.0, 1) << " ms (" << juce::String(realtimeFactor, 0) << "x realtime)" << std::endl;
+        if (result.stats.isNotEmpty())
+        {
+            std::cout << result.stats;
+        }
+    }
+
+    void printUsage()
+    {
+        std::cout << "usage: midilatch-render [options] file.mid...\n"
+                     "       midilatch-render --make-library <library.mlib> mapping.txt...\n"
+                     "       midilatch-render --fuzz [--seed <n>] [--runs <n>] [--events <n>] [options]\n"
+                     "       midilatch-render --bench [--blocks <n>] [--sample-rate <hz>] [--block-size <samples>]\n"
+                     "  --sample-rate <hz>      host sample rate the blocks are cut for (default 48000)\n"
+                     "  --block-size <samples>  host block size (default 512)\n"
+                     "  --state <file>          saved plugin state or exported mapping to load\n"
+                     "  --minimal-transitions   only send the notes that differ between chords\n"
+                     "  --pace-din              pace the output to what a DIN midi port can carry\n"
+                     "  --output-dir <dir>      where to write the -latched.mid files (default: next to the input)\n"
+                     "  --jobs <n>              render this many files at once (default 1, 0 for one per core)\n"
+                     "  --stats                 print the processor's performance counters for each file\n"
+                     "  --make-library <file>   write exported text mappings into a chord library, one song per file\n"
+                     "  --fuzz                  check the processor against a reference model with random midi, block\n"
+                     "                          sizes (up to --block-size) and states, and time it\n"
+                     "  --seed <n>              first run's seed (default: random), run i uses seed + i\n"
+                     "  --runs <n>              fuzz runs (default 1000)\n"
+                     "  --events <n>            midi events per fuzz run (default 2000)\n"
+                     "  --bench                 time processBlock on synthetic workloads and count its heap allocations\n"
+                     "  --blocks <n>            blocks per bench workload (default 20000)\n";
+    }
+
+    int run(const juce::ArgumentList& args)
+    {
+        if (args.size() == 0 || args.containsOption("--help|-h"))
+        {
+            printUsage();
+            return args.size() == 0 ? 1 : 0;
+        }
+
+        if (args.containsOption("--make-library"))
+        {
+            const auto inputs = getInputFiles(args);
+            if (inputs.isEmpty())
+            {
+                juce::ConsoleApplication::fail("no mapping files");
+            }
+            return makeLibrary(args.getFileForOption("--make-library"), inputs);
+        }
+
+        RenderOptions options;
+        if (args.containsOption("--sample-rate"))
+        {
+            options.sampleRate = args.getValueForOption("--sample-rate").getDoubleValue();
+        }
+        if (args.containsOption("--block-size"))
+        {
+            options.blockSize = args.getValueForOption("--block-size").getIntValue();
+        }
+        if (options.sampleRate <= 0.0 || options.blockSize <= 0)
+        {
+            juce::ConsoleApplication::fail("sample rate and block size must be positive");
+        }
+        if (args.containsOption("--state"))
+        {
+            const auto stateFile = args.getExistingFileForOption("--state");
+            const auto result = loadState(stateFile, options.state);
+            if (result.failed())
+            {
+                juce::ConsoleApplication::fail(stateFile.getFileName() + ": " + result.getErrorMessage());
+            }
+        }
+        options.minimalTransitions = args.containsOption("--minimal-transitions");
+        options.paceToDinMidi = args.containsOption("--pace-din");
+        options.printStats = args.containsOption("--stats");
+        if (args.containsOption("--output-dir"))
+        {
+            options.outputDirectory = args.getFileForOption("--output-dir");
+            options.outputDirectory.createDirectory();
+        }
+        int numJobs = args.containsOption("--jobs") ? args.getValueForOption("--jobs").getIntValue() : 1;
+        if (numJobs <= 0)
+        {
+            numJobs = juce::SystemStats::getNumCpus();
+        }
+
+        if (args.containsOption("--bench"))
+        {
+            LatchBench::Options benchOptions;
+            if (args.containsOption("--blocks"))
+            {
+                benchOptions.blocksPerWorkload = args.getValueForOption("--blocks").getIntValue();
+            }
+            if (benchOptions.blocksPerWorkload <= 0)
+            {
+                juce::ConsoleApplication::fail("blocks must be positive");
+            }
+            benchOptions.sampleRate = options.sampleRate;
+            benchOptions.blockSize = options.blockSize;
+            return LatchBench::run(benchOptions);
+        }
+
+        if (args.containsOption("--fuzz"))
+        {
+            LatchFuzzer::Options fuzzOptions;
+            fuzzOptions.seed = args.containsOption("--seed") ? args.getValueForOption("--seed").getLargeIntValue()
+                                                             : juce::Random::getSystemRandom().nextInt64() & 0xffffffffffff;
+            if (args.containsOption("--runs"))
+            {
+                fuzzOptions.runs = args.getValueForOption("--runs").getIntValue();
+            }
+            if (args.containsOption("--events"))
+            {
+                fuzzOptions.eventsPerRun = args.getValueForOption("--events").getIntValue();
+            }
+            if (fuzzOptions.runs <= 0 || fuzzOptions.eventsPerRun <= 0)
+            {
+                juce::ConsoleApplication::fail("runs and events must be positive");
+            }
+            fuzzOptions.sampleRate = options.sampleRate;
+            fuzzOptions.maxBlockSize = options.blockSize;
+            fuzzOptions.numJobs = juce::jmin(numJobs, fuzzOptions.runs);
+            return LatchFuzzer::run(fuzzOptions);
+        }
+
+        const auto inputs = getInputFiles(args);
+        if (inputs.isEmpty())
+        {
+            juce::ConsoleApplication::fail("no input files");
+        }
+        numJobs = juce::jmin(numJobs, inputs.size());
+
+        // Every file gets its own processor, so files are independent of each other and
+        // can be rendered on any thread. Results are printed in input order.
+        std::vector<RenderResult> results((size_t) inputs.size());
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+        {
+            juce::ThreadPool pool(numJobs);
+            for (int i = 0; i < inputs.size(); ++i)
+            {
+                pool.addJob([&options, &inputs, &results, i]
+                {
+                    auto fileOptions = options;
+                    if (fileOptions.outputDirectory == juce::File())
+                    {
+                        fileOptions.outputDirectory = inputs[i].getParentDirectory();
+                    }
+                    results[(size_t) i] = renderFile(inputs[i], fileOptions);
+                });
+            }
+            while (pool.getNumJobs() > 0)
+            {
+                juce::Thread::sleep(10);
+            }
+        }
+        const double wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        int failures = 0;
+        for (const auto& result : results)
+        {
+            printResult(result);
+            failures += result.error.isNotEmpty() ? 1 : 0;
+        }
+        if (inputs.size() > 1)
+        {
+            std::cout << inputs.size() << " files in " << juce::String(wallSeconds, 2) << " s on " << numJobs << " threads" << std::endl;
+        }
+        return failures == 0 ? 0 : 1;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // The processor owns a timer, which needs a message manager even if no loop runs
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+    return juce::ConsoleApplication::invokeCatchingFailures([&args] { return run(args); });
+}
@@ -0,0 +1,330 @@
+/*
+  ==============================================================================
+
+    ReferenceLatch.h
+    A deliberately plain model of what the plugin does to a midi stream, for
+    checking the real thing against. No JUCE, no bit tricks, no prebuilt events.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "LatchEngine.h"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Follows MidilatchAudioProcessor message by message with strumming, output pacing and
+// sending matched program changes off, using ordered maps and whole-chord loops where
+// the processor uses bitsets, specialised engines and prebuilt events. It only borrows
+// the two setting enums from LatchEngine.h.
+//
+// The model writes the same messages as the processor, with the same timing. Messages
+// at the same time may come out in another order as long as every note sees its own
+// messages in the same order, so compare them by sameNoteOrder().
+class ReferenceLatch
+{
+public:
+    // Mapping key (bank * 128 + program) to the notes of the chord, in their stored order
+    using Mapping = std::map<int, std::vector<int>>;
+
+    struct Settings
+    {
+        bool recording = false;
+        bool minimalTransitions = false;
+        SharedNotePolicy sharedNotePolicy = SharedNotePolicy::keepSounding;
+        bool latchChannelsSeparately = false;
+        // 0-15
+        int mappingChannelIndex = 0;
+        int transposeOffset = 0;
+        TransposeBounds transposeBounds = TransposeBounds::fold;
+        // In samples, 0 for held keys
+        std::int64_t captureWindow = 0;
+    };
+
+    struct Message
+    {
+        std::int64_t time;
+        std::vector<std::uint8_t> bytes;
+    };
+
+    // Both take effect for the following messages, the processor applies them at the
+    // start of the next block
+    void setMapping(Mapping newMapping)
+    {
+        mapping = std::move(newMapping);
+    }
+    void setSettings(const Settings& newSettings)
+    {
+        if (newSettings.latchChannelsSeparately != settings.latchChannelsSeparately)
+        {
+            // Latched notes stay latched, every latch starts a new chord
+            for (auto& latch : latches) { latch = {}; }
+        }
+        settings = newSettings;
+    }
+    const Settings& getSettings() const { return settings; }
+
+    // Appends what the processor writes for one input message at time to output
+    void process(const std::int64_t time, const std::uint8_t* data, const int size, std::vector<Message>& output)
+    {
+        const auto send = [&](std::vector<std::uint8_t> bytes) { output.push_back({ time, std::move(bytes) }); };
+        if (size != 2 && size != 3)
+        {
+            send({ data, data + size });
+            return;
+        }
+        const int type = data[0] & 0xf0;
+        const int channel = data[0] & 0x0f;
+        const int latchIndex = latchOf(channel);
+        auto& latch = latches[(size_t) latchIndex];
+
+        if (size == 3 && type == 0x90 && data[2] != 0)
+        {
+            const int note = data[1];
+            const int velocity = data[2];
+            if (settings.captureWindow > 0)
+            {
+                latch.isRecording = latch.chordStart.has_value() && time >= *latch.chordStart && time - *latch.chordStart < settings.captureWindow;
+                if (!latch.isRecording) { latch.chordStart = time; }
+            }
+            if (!latch.isRecording)
+            {
+                if (settings.minimalTransitions) { release(latchIndex, std::make_pair(note, channel), time, output); }
+                else { release(latchIndex, std::nullopt, time, output); }
+            }
+            latch.isRecording = true;
+            const auto key = std::make_pair(note, channel);
+            if (settings.minimalTransitions && notes.count(key) > 0)
+            {
+                if (settings.sharedNotePolicy == SharedNotePolicy::retriggerIfVelocityChanged && notes[key] != velocity)
+                {
+                    send(noteOff(channel, note));
+                    send(noteOn(channel, note, velocity));
+                    notes[key] = velocity;
+                }
+                return;
+            }
+            // A key pressed twice keeps the velocity it was latched with
+            notes.emplace(key, velocity);
+            send(noteOn(channel, note, velocity));
+            return;
+        }
+        if (size == 3 && (type == 0x80 || type == 0x90))
+        {
+            latch.isRecording = false;
+            return;
+        }
+        if (size == 3 && type == 0xb0 && data[1] == 123)
+        {
+            // The receiver silences the message's own channel, the rest needs note offs
+            for (auto it = notes.begin(); it != notes.end();)
+            {
+                const auto [note, noteChannel] = it->first;
+                if (latchOf(noteChannel) != latchIndex) { ++it; continue; }
+                if (noteChannel != channel) { send(noteOff(noteChannel, note)); }
+                it = notes.erase(it);
+            }
+            latch.chordStart.reset();
+            send({ data, data + size });
+            return;
+        }
+        if (size == 3 && type == 0xb0 && (data[1] == 0 || data[1] == 32))
+        {
+            auto& bank = selectedBank[(size_t) channel];
+            bank = data[1] == 0 ? data[2] * 128 + bank % 128 : bank / 128 * 128 + data[2];
+            send({ data, data + size });
+            return;
+        }
+        if (type == 0xc0)
+        {
+            if (settings.recording)
+            {
+                // Stored as a chord, not sent
+                return;
+            }
+            const auto chord = mapping.find(selectedBank[(size_t) channel] * 128 + data[1]);
+            if (chord != mapping.end() && settings.minimalTransitions)
+            {
+                transition(latchIndex, chord->second, time, output);
+            }
+            else
+            {
+                release(latchIndex, std::nullopt, time, output);
+                if (chord != mapping.end()) { fire(latchIndex, chord->second, time, output); }
+            }
+            latch.isRecording = false;
+            latch.chordStart.reset();
+            return;
+        }
+        send({ data, data + size });
+    }
+
+    // The notes currently latched, as (note, channel)
+    std::set<std::pair<int, int>> getLatchedNotes() const
+    {
+        std::set<std::pair<int, int>> latched;
+        for (const auto& [key, velocity] : notes) { latched.insert(key); }
+        return latched;
+    }
+
+    // True if both hold the same messages at the same times, and every note's messages
+    // in the same order. Messages other than note ons and offs keep their exact place.
+    static bool sameNoteOrder(const std::vector<Message>& a, const std::vector<Message>& b)
+    {
+        if (a.size() != b.size()) { return false; }
+        size_t start = 0;
+        while (start < a.size())
+        {
+            // A run of notes at one time, or a single other message
+            size_t end = start + 1;
+            if (isNote(a[start]))
+            {
+                while (end < a.size() && a[end].time == a[start].time && isNote(a[end])) { ++end; }
+            }
+            for (size_t i = start; i < end; ++i)
+            {
+                if (b[i].time != a[start].time || isNote(b[i]) != isNote(a[start])) { return false; }
+            }
+            // Messages of one note are compared in order, different notes are independent
+            std::map<std::pair<int, int>, std::vector<std::vector<std::uint8_t>>> notesA, notesB;
+            for (size_t i = start; i < end; ++i)
+            {
+                notesA[noteKey(a[i])].push_back(a[i].bytes);
+                notesB[noteKey(b[i])].push_back(b[i].bytes);
+            }
+            if (notesA != notesB) { return false; }
+            start = end;
+        }
+        return true;
+    }
+
+private:
+    struct Latch
+    {
+        bool isRecording = false;
+        std::optional<std::int64_t> chordStart;
+    };
+
+    static std::vector<std::uint8_t> noteOn(const int channel, const int note, const int velocity)
+    {
+        return { (std::uint8_t) (0x90 | channel), (std::uint8_t) note, (std::uint8_t) velocity };
+    }
+    static std::vector<std::uint8_t> noteOff(const int channel, const int note)
+    {
+        return { (std::uint8_t) (0x80 | channel), (std::uint8_t) note, 0 };
+    }
+    static bool isNote(const Message& message)
+    {
+        return message.bytes.size() == 3 && ((message.bytes[0] & 0xf0) == 0x80 || (message.bytes[0] & 0xf0) == 0x90);
+    }
+    static std::pair<int, int> noteKey(const Message& message)
+    {
+        return isNote(message) ? std::make_pair(message.bytes[0] & 0x0f, (int) message.bytes[1]) : std::make_pair(-1, -1);
+    }
+
+    int latchOf(const int channel) const { return settings.latchChannelsSeparately ? channel : 0; }
+    int mappingChannelOf(const int latchIndex) const { return settings.latchChannelsSeparately ? latchIndex : settings.mappingChannelIndex; }
+
+    // The note a stored note is played as, -1 if it is dropped
+    int transpose(const int note) const
+    {
+        int transposed = note + settings.transposeOffset;
+        if (transposed >= 0 && transposed <= 127) { return transposed; }
+        switch (settings.transposeBounds)
+        {
+            case TransposeBounds::fold:
+                while (transposed < 0) { transposed += 12; }
+                while (transposed > 127) { transposed -= 12; }
+                return transposed;
+            case TransposeBounds::clamp:
+                return transposed < 0 ? 0 : 127;
+            case TransposeBounds::drop:
+                break;
+        }
+        return -1;
+    }
+
+    // Releases the latch's notes, except keep if it is latched
+    void release(const int latchIndex, const std::optional<std::pair<int, int>> keep, const std::int64_t time, std::vector<Message>& output)
+    {
+        for (auto it = notes.begin(); it != notes.end();)
+        {
+            const auto [note, channel] = it->first;
+            if (latchOf(channel) != latchIndex || it->first == keep) { ++it; continue; }
+            output.push_back({ time, noteOff(channel, note) });
+            it = notes.erase(it);
+        }
+    }
+
+    void fire(const int latchIndex, const std::vector<int>& chord, const std::int64_t time, std::vector<Message>& output)
+    {
+        const int channel = mappingChannelOf(latchIndex);
+        if (settings.transposeOffset == 0)
+        {
+            for (int note : chord)
+            {
+                notes.emplace(std::make_pair(note, channel), 127);
+                output.push_back({ time, noteOn(channel, note, 127) });
+            }
+            return;
+        }
+        std::set<int> started;
+        for (int storedNote : chord)
+        {
+            const int note = transpose(storedNote);
+            if (note < 0 || !started.insert(note).second) { continue; }
+            notes.emplace(std::make_pair(note, channel), 127);
+            output.push_back({ time, noteOn(channel, note, 127) });
+        }
+    }
+
+    // Minimal transitions to a mapped chord
+    void transition(const int latchIndex, const std::vector<int>& chord, const std::int64_t time, std::vector<Message>& output)
+    {
+        const int channel = mappingChannelOf(latchIndex);
+        std::vector<int> played;
+        for (int note : chord) { played.push_back(transpose(note)); }
+        const std::set<int> pitches(played.begin(), played.end());
+
+        std::set<int> toStart;
+        for (int note : pitches)
+        {
+            if (note >= 0 && notes.count(std::make_pair(note, channel)) == 0) { toStart.insert(note); }
+        }
+        for (auto it = notes.begin(); it != notes.end();)
+        {
+            const auto [note, noteChannel] = it->first;
+            if (latchOf(noteChannel) != latchIndex) { ++it; continue; }
+            if (noteChannel != channel || pitches.count(note) == 0)
+            {
+                output.push_back({ time, noteOff(noteChannel, note) });
+                it = notes.erase(it);
+                continue;
+            }
+            if (settings.sharedNotePolicy == SharedNotePolicy::retriggerIfVelocityChanged && it->second != 127)
+            {
+                output.push_back({ time, noteOff(noteChannel, note) });
+                toStart.insert(note);
+            }
+            ++it;
+        }
+        for (int note : played)
+        {
+            if (note < 0 || toStart.erase(note) == 0) { continue; }
+            output.push_back({ time, noteOn(channel, note, 127) });
+            notes[std::make_pair(note, channel)] = 127;
+        }
+    }
+
+    Settings settings;
+    Mapping mapping;
+    // (note, channel) to the velocity it was latched with
+    std::map<std::pair<int, int>, int> notes;
+    std::vector<Latch> latches = std::vector<Latch>(16);
+    std::vector<int> selectedBank = std::vector<int>(16, 0);
+};
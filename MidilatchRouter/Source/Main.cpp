@@ -0,0 +1,520 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    midilatch-router: runs the plugin's latch and mapping logic without a host,
+    straight between midi ports. Several inputs are merged by timestamp into one
+    stream and the result goes to a single output, in real time.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "StateFormat.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+namespace
+{
+    std::atomic<bool> stopRequested { false };
+
+    extern "C" void requestStop(int)
+    {
+        stopRequested.store(true);
+    }
+
+    // Ends the message loop once a stop is requested; the signal handler can only set
+    // the flag
+    class StopPoller : private juce::Timer
+    {
+    public:
+        StopPoller() { startTimer(50); }
+        ~StopPoller() override { stopTimer(); }
+
+    private:
+        void timerCallback() override
+        {
+            if (stopRequested.load()) { juce::MessageManager::getInstance()->stopDispatchLoop(); }
+        }
+    };
+
+    // Seconds on the clock midi devices timestamp their input with
+    double now()
+    {
+        return juce::Time::getMillisecondCounterHiRes() * 0.001;
+    }
+
+    // Latencies in 10 microsecond buckets up to 100 ms, so recording one never allocates
+    class LatencyHistogram
+    {
+    public:
+        void add(double seconds)
+        {
+            const auto bucket = (size_t) juce::jlimit(0, numBuckets - 1, (int) (seconds * 1.0e6 / bucketMicroseconds));
+            ++buckets[bucket];
+            ++count;
+            sum += seconds;
+            maximum = juce::jmax(maximum, seconds);
+        }
+
+        juce::String toText() const
+        {
+            if (count == 0) { return "no events"; }
+            auto ms = [](double seconds) { return juce::String(seconds * 1000.0, 2) + " ms"; };
+            return juce::String(count) + " events, mean " + ms(sum / (double) count) + ", median " + ms(getPercentile(0.5))
+                 + ", 99% " + ms(getPercentile(0.99)) + ", max " + ms(maximum);
+        }
+
+    private:
+        static constexpr int bucketMicroseconds = 10;
+        static constexpr int numBuckets = 10000;
+
+        // The upper edge of the bucket the percentile falls into
+        double getPercentile(double fraction) const
+        {
+            const auto target = (juce::int64) std::ceil(fraction * (double) count);
+            juce::int64 seen = 0;
+            for (size_t bucket = 0; bucket < buckets.size(); ++bucket)
+            {
+                seen += buckets[bucket];
+                if (seen >= target) { return juce::jmin(maximum, (double) (bucket + 1) * bucketMicroseconds * 1.0e-6); }
+            }
+            return maximum;
+        }
+
+        std::array<juce::int64, numBuckets> buckets {};
+        juce::int64 count = 0;
+        double sum = 0.0;
+        double maximum = 0.0;
+    };
+
+    struct TimedMessage
+    {
+        double time;
+        juce::uint8 data[3];
+        juce::uint8 size;
+        juce::uint8 input;
+    };
+
+    // One per open input. The device's thread is the only producer and the router
+    // thread the only consumer, so inputs never contend with each other. Only channel
+    // messages are routed; sysex and realtime messages are dropped.
+    class InputQueue : public juce::MidiInputCallback
+    {
+    public:
+        InputQueue(int inputIndex, juce::WaitableEvent& wakeUp) : index((juce::uint8) inputIndex), dataAvailable(wakeUp) {}
+
+        void handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage& message) override
+        {
+            const int size = message.getRawDataSize();
+            if (size > 3 || message.getRawData()[0] >= 0xf0)
+            {
+                return;
+            }
+            const auto scope = fifo.write(1);
+            if (scope.blockSize1 == 0)
+            {
+                overflows.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            auto& slot = messages[(size_t) scope.startIndex1];
+            // Devices stamp their messages on the same clock as now(), on arrival
+            slot.time = message.getTimeStamp() > 0.0 ? message.getTimeStamp() : now();
+            std::copy_n(message.getRawData(), size, slot.data);
+            slot.size = (juce::uint8) size;
+            slot.input = index;
+            dataAvailable.signal();
+        }
+
+        // Router thread only. Appends what arrived since the last call.
+        template <typename Consumer>
+        void drain(Consumer&& consume)
+        {
+            const auto scope = fifo.read(fifo.getNumReady());
+            for (int i = 0; i < scope.blockSize1; ++i) { consume(messages[(size_t) (scope.startIndex1 + i)]); }
+            for (int i = 0; i < scope.blockSize2; ++i) { consume(messages[(size_t) (scope.startIndex2 + i)]); }
+        }
+
+        int getOverflows() const { return overflows.load(); }
+
+        std::unique_ptr<juce::MidiInput> device;
+
+    private:
+        static constexpr int capacity = 1024;
+
+        const juce::uint8 index;
+        juce::WaitableEvent& dataAvailable;
+        juce::AbstractFifo fifo { capacity };
+        std::array<TimedMessage, capacity> messages {};
+        std::atomic<int> overflows { 0 };
+
+        JUCE_DECLARE_NON_COPYABLE(InputQueue)
+    };
+
+    // Wakes up when any input has data, or every block period so strummed and paced
+    // notes go out on time. Each pass processes one block that ends now and starts where
+    // the last one ended, with every message placed at the sample it arrived at, and
+    // sends the processor's output right away. Nothing in the loop allocates.
+    class Router : public juce::Thread
+    {
+    public:
+        Router(MidilatchAudioProcessor& processorToUse, juce::OwnedArray<InputQueue>& inputsToUse, juce::MidiOutput& outputToUse,
+               double sampleRateToUse, double blockMs)
+            : juce::Thread("midilatch router"), processor(processorToUse), inputs(inputsToUse), output(outputToUse),
+              sampleRate(sampleRateToUse), blockPeriodMs(juce::jmax(1, juce::roundToInt(blockMs))),
+              // A late wake up is caught up in one block rather than many small ones
+              maxBlockSize(juce::jmax(64, juce::roundToInt(sampleRateToUse * blockMs * 0.004)))
+        {
+            pending.resize((size_t) maxPendingMessages);
+            processor.setRateAndBufferSizeDetails(sampleRate, maxBlockSize);
+            processor.prepareToPlay(sampleRate, maxBlockSize);
+            audio.setSize(juce::jmax(1, processor.getTotalNumOutputChannels()), maxBlockSize);
+            midi.ensureSize((size_t) maxPendingMessages * 8);
+        }
+
+        ~Router() override
+        {
+            stopThread(1000);
+            processor.releaseResources();
+        }
+
+        juce::WaitableEvent wakeUp;
+
+        // Only once the thread has stopped
+        const LatencyHistogram& getLatencies() const { return latencies; }
+        juce::int64 getBlocks() const { return blocks; }
+        int getMessagesOut() const { return messagesOut; }
+
+    private:
+        static constexpr int maxPendingMessages = 4096;
+
+        void run() override
+        {
+            double blockStartTime = now();
+            while (!threadShouldExit())
+            {
+                wakeUp.wait(blockPeriodMs);
+
+                int numPending = 0;
+                for (auto* input : inputs)
+                {
+                    input->drain([this, &numPending](const TimedMessage& message)
+                    {
+                        if (numPending < maxPendingMessages) { pending[(size_t) numPending++] = message; }
+                    });
+                }
+                // Each input is in order already; ties between inputs go to the lower one
+                std::sort(pending.begin(), pending.begin() + numPending, [](const TimedMessage& a, const TimedMessage& b)
+                {
+                    return a.time < b.time || (a.time == b.time && a.input < b.input);
+                });
+
+                // Taken after draining, so every message drained arrived before the block ends
+                const double blockEndTime = now();
+                int numSamples = (int) ((blockEndTime - blockStartTime) * sampleRate);
+                if (numSamples <= 0 && numPending == 0)
+                {
+                    continue;
+                }
+                numSamples = juce::jmax(1, numSamples);
+                if (numSamples > maxBlockSize)
+                {
+                    blockStartTime = blockEndTime - maxBlockSize / sampleRate;
+                    numSamples = maxBlockSize;
+                }
+
+                midi.clear();
+                for (int i = 0; i < numPending; ++i)
+                {
+                    const auto& message = pending[(size_t) i];
+                    const int position = juce::jlimit(0, numSamples - 1, (int) ((message.time - blockStartTime) * sampleRate));
+                    midi.addEvent(message.data, message.size, position);
+                }
+                audio.clear();
+                processor.processBlock(audio, midi);
+
+                for (const auto metadata : midi)
+                {
+                    output.sendMessageNow(metadata.getMessage());
+                    ++messagesOut;
+                }
+                const double sentTime = now();
+                for (int i = 0; i < numPending; ++i)
+                {
+                    latencies.add(sentTime - pending[(size_t) i].time);
+                }
+                blockStartTime += numSamples / sampleRate;
+                ++blocks;
+            }
+        }
+
+        MidilatchAudioProcessor& processor;
+        juce::OwnedArray<InputQueue>& inputs;
+        juce::MidiOutput& output;
+        const double sampleRate;
+        const int blockPeriodMs;
+        const int maxBlockSize;
+
+        std::vector<TimedMessage> pending;
+        juce::AudioBuffer<float> audio;
+        juce::MidiBuffer midi;
+        LatencyHistogram latencies;
+        juce::int64 blocks = 0;
+        int messagesOut = 0;
+
+        JUCE_DECLARE_NON_COPYABLE(Router)
+    };
+
+    // A device named exactly like the query, else by its list index, else the first
+    // whose name contains it
+    std::optional<juce::MidiDeviceInfo> findDevice(const juce::Array<juce::MidiDeviceInfo>& devices, const juce::String& query)
+    {
+        for (const auto& device : devices)
+        {
+            if (device.name == query || device.identifier == query) { return device; }
+        }
+        if (query.containsOnly("0123456789") && juce::isPositiveAndBelow(query.getIntValue(), devices.size()))
+        {
+            return devices[query.getIntValue()];
+        }
+        for (const auto& device : devices)
+        {
+            if (device.name.containsIgnoreCase(query)) { return device; }
+        }
+        return std::nullopt;
+    }
+
+    void listDevices()
+    {
+        std::cout << "inputs:\n";
+        const auto inputs = juce::MidiInput::getAvailableDevices();
+        for (int i = 0; i < inputs.size(); ++i) { std::cout << "  " << i << ": " << inputs[i].name << "\n"; }
+        std::cout << "outputs:\n";
+        const auto outputs = juce::MidiOutput::getAvailableDevices();
+        for (int i = 0; i < outputs.size(); ++i) { std::cout << "  " << i << ": " << outputs[i].name << "\n"; }
+        std::cout << std::flush;
+    }
+
+    // Every value of an option that may be given more than once
+    juce::StringArray getValuesForOption(const juce::ArgumentList& args, const juce::String& option)
+    {
+        juce::StringArray values;
+        for (int i = 0; i + 1 < args.size(); ++i)
+        {
+            if (args[i].text == option) { values.add(args[++i].text); }
+        }
+        return values;
+    }
+
+    std::unique_ptr<juce::MidiOutput> openOutput(const juce::ArgumentList& args)
+    {
+        if (args.containsOption("--virtual-output"))
+        {
+            const auto name = args.getValueForOption("--virtual-output");
+            auto output = juce::MidiOutput::createNewDevice(name);
+            if (output == nullptr) { juce::ConsoleApplication::fail("could not create virtual output " + name); }
+            return output;
+        }
+        const auto query = args.getValueForOption("--output");
+        const auto device = findDevice(juce::MidiOutput::getAvailableDevices(), query);
+        auto output = device ? juce::MidiOutput::openDevice(device->identifier) : nullptr;
+        if (output == nullptr) { juce::ConsoleApplication::fail("could not open output " + query); }
+        return output;
+    }
+
+    void openInput(InputQueue& queue, const juce::String& query, bool isVirtual)
+    {
+        if (isVirtual)
+        {
+            queue.device = juce::MidiInput::createNewDevice(query, &queue);
+        }
+        else if (const auto device = findDevice(juce::MidiInput::getAvailableDevices(), query))
+        {
+            queue.device = juce::MidiInput::openDevice(device->identifier, &queue);
+        }
+        if (queue.device == nullptr) { juce::ConsoleApplication::fail("could not open input " + query); }
+    }
+
+    // Either a state saved by the plugin or a mapping exported as text
+    juce::Result loadState(const juce::File& file, juce::MemoryBlock& state)
+    {
+        if (!file.loadFileAsData(state))
+        {
+            return juce::Result::fail("could not read " + file.getFullPathName());
+        }
+        MidiMapping mapping;
+        if (StateFormat::isBinary(state.getData(), state.getSize()))
+        {
+            StateFormat::Settings settings;
+            return StateFormat::read(state.getData(), state.getSize(), mapping, settings);
+        }
+        return mapping.parseStringSerialization(state.toString().toStdString());
+    }
+
+    // Plays probe notes into one port and times the first note on that comes back on
+    // another after each, with a router in between
+    class LatencyProbe : public juce::MidiInputCallback
+    {
+    public:
+        void handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage& message) override
+        {
+            if (!message.isNoteOn()) { return; }
+            const double sentAt = probeSentAt.exchange(0.0);
+            if (sentAt > 0.0) { latencies.add(now() - sentAt); }
+        }
+
+        std::atomic<double> probeSentAt { 0.0 };
+        LatencyHistogram latencies;
+    };
+
+    int measure(const juce::ArgumentList& args)
+    {
+        const int count = args.containsOption("--count") ? args.getValueForOption("--count").getIntValue() : 500;
+        const int intervalMs = args.containsOption("--interval-ms") ? args.getValueForOption("--interval-ms").getIntValue() : 20;
+        const auto inputs = getValuesForOption(args, "--input");
+        if (inputs.size() != 1 || count <= 0 || intervalMs <= 0)
+        {
+            juce::ConsoleApplication::fail("--measure needs one --input, one --output and a positive count and interval");
+        }
+
+        LatencyProbe probe;
+        const auto device = findDevice(juce::MidiInput::getAvailableDevices(), inputs[0]);
+        auto input = device ? juce::MidiInput::openDevice(device->identifier, &probe) : nullptr;
+        if (input == nullptr) { juce::ConsoleApplication::fail("could not open input " + inputs[0]); }
+        auto output = openOutput(args);
+        input->start();
+
+        // Alternating notes, so each probe latches a new chord instead of releasing one
+        int lost = 0;
+        for (int i = 0; i < count && !stopRequested.load(); ++i)
+        {
+            const int note = i % 2 == 0 ? 60 : 67;
+            lost += probe.probeSentAt.exchange(now()) > 0.0 ? 1 : 0;
+            output->sendMessageNow(juce::MidiMessage::noteOn(1, note, (juce::uint8) 100));
+            output->sendMessageNow(juce::MidiMessage::noteOff(1, note));
+            juce::Thread::sleep(intervalMs);
+        }
+        juce::Thread::sleep(intervalMs);
+        lost += probe.probeSentAt.exchange(0.0) > 0.0 ? 1 : 0;
+        input->stop();
+
+        std::cout << "round trip: " << probe.latencies.toText() << ", " << lost << " lost" << std::endl;
+        return lost == 0 ? 0 : 1;
+    }
+
+    void printUsage()
+    {
+        std::cout << "usage: midilatch-router [options] --input <port>... (--output <port> | --virtual-output <name>)\n"
+                     "       midilatch-router --list\n"
+                     "       midilatch-router --measure --input <port> --output <port> [--count <n>] [--interval-ms <ms>]\n"
+                     "  --input <port>            input to merge, by name, list index or part of the name; repeatable\n"
+                     "  --virtual-input <name>    create an input other programs can connect to; repeatable\n"
+                     "  --output <port>           output to send to\n"
+                     "  --virtual-output <name>   create an output other programs can connect to\n"
+                     "  --state <file>            saved plugin state or exported mapping to load\n"
+                     "  --sample-rate <hz>        rate the processor's sample positions are counted at (default 48000)\n"
+                     "  --block-ms <ms>           longest wait between two blocks (default 1)\n"
+                     "  --stats                   on exit, print input to output latencies and the performance counters\n"
+                     "  --measure                 time round trips through a router, sending probes to --output\n"
+                     "                            and listening for them on --input\n";
+    }
+
+    int run(const juce::ArgumentList& args)
+    {
+        if (args.size() == 0 || args.containsOption("--help|-h"))
+        {
+            printUsage();
+            return args.size() == 0 ? 1 : 0;
+        }
+        if (args.containsOption("--list"))
+        {
+            listDevices();
+            return 0;
+        }
+
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+        if (args.containsOption("--measure"))
+        {
+            return measure(args);
+        }
+
+        const double sampleRate = args.containsOption("--sample-rate") ? args.getValueForOption("--sample-rate").getDoubleValue() : 48000.0;
+        const double blockMs = args.containsOption("--block-ms") ? args.getValueForOption("--block-ms").getDoubleValue() : 1.0;
+        if (sampleRate <= 0.0 || blockMs <= 0.0)
+        {
+            juce::ConsoleApplication::fail("sample rate and block period must be positive");
+        }
+        const auto inputNames = getValuesForOption(args, "--input");
+        const auto virtualInputNames = getValuesForOption(args, "--virtual-input");
+        if (inputNames.size() + virtualInputNames.size() == 0 || !(args.containsOption("--output") || args.containsOption("--virtual-output")))
+        {
+            juce::ConsoleApplication::fail("needs at least one input and an output");
+        }
+
+        MidilatchAudioProcessor processor;
+        if (args.containsOption("--state"))
+        {
+            const auto stateFile = args.getExistingFileForOption("--state");
+            juce::MemoryBlock state;
+            const auto result = loadState(stateFile, state);
+            if (result.failed())
+            {
+                juce::ConsoleApplication::fail(stateFile.getFileName() + ": " + result.getErrorMessage());
+            }
+            processor.setStateInformation(state.getData(), (int) state.getSize());
+        }
+
+        auto output = openOutput(args);
+        juce::OwnedArray<InputQueue> inputs;
+        Router router(processor, inputs, *output, sampleRate, blockMs);
+        for (const auto& name : inputNames)
+        {
+            openInput(*inputs.add(new InputQueue(inputs.size(), router.wakeUp)), name, false);
+        }
+        for (const auto& name : virtualInputNames)
+        {
+            openInput(*inputs.add(new InputQueue(inputs.size(), router.wakeUp)), name, true);
+        }
+
+        router.startThread(juce::Thread::Priority::highest);
+        for (auto* input : inputs) { input->device->start(); }
+        std::cout << "routing " << inputs.size() << " inputs to " << output->getName() << ", ctrl-c to stop" << std::endl;
+        {
+            // The processor's timer applies recorded chords and frees the mapping
+            // snapshots the router thread is done with, so this thread runs the message
+            // loop until stopped
+            StopPoller stopPoller;
+            juce::MessageManager::getInstance()->runDispatchLoop();
+        }
+        for (auto* input : inputs) { input->device->stop(); }
+        router.stopThread(1000);
+
+        int overflows = 0;
+        for (auto* input : inputs) { overflows += input->getOverflows(); }
+        std::cout << router.getBlocks() << " blocks, " << router.getMessagesOut() << " messages out";
+        std::cout << (overflows > 0 ? ", " + juce::String(overflows) + " dropped on full input queues" : juce::String()) << std::endl;
+        if (args.containsOption("--stats"))
+        {
+            std::cout << "input to output: " << router.getLatencies().toText() << "\n"
+                      << processor.getPerformanceCounters().getSnapshot().toText();
+        }
+        return 0;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // The processor owns a timer, which runs on the message loop run() dispatches
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+    return juce::ConsoleApplication::invokeCatchingFailures([&args] { return run(args); });
+}